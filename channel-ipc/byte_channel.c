@@ -0,0 +1,287 @@
+#include "byte_channel.h"
+#include <string.h>
+
+//a byte channel is one ring of bytes with free-running head and tail positions,
+//indexed with mask like the SPSC channel; the producer is the only writer of
+//tail and the consumer the only writer of head, each caches the other's index
+//a message takes HEADER bytes for its length plus its bytes, rounded up to
+//HEADER so the next header and every message body stay aligned
+//a message never crosses the end of the ring: if it does not fit before the
+//end, a WRAP header fills the rest and the message starts at offset 0
+//capping messages at half the ring means one always fits an empty ring,
+//either before the end or after a wrap
+//reserve only computes where the message goes, commit writes the headers and
+//publishes tail; peek hands out a pointer into the ring and release publishes
+//head, so the message bytes are written once and never copied
+//a full or empty ring parks on the conds; the parking side sets its waiting
+//flag before its last check and the other side only takes the lock to wake it
+//when the flag is set
+
+#define HEADER sizeof(size_t)
+#define WRAP ((size_t)-1)
+
+static size_t record_size(size_t len) {
+	return (HEADER + len + HEADER - 1) & ~(HEADER - 1);
+}
+
+static bool byte_closed(byte_channel_t* channel) {
+	return __atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE);
+}
+
+static size_t* header_at(byte_channel_t* channel, size_t pos) {
+	return (size_t*)(channel->data + (pos & channel->mask));
+}
+
+//wake the side parked on cond, if any
+static void byte_wake(byte_channel_t* channel, int* waiting, pthread_cond_t* cond) {
+	if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&channel->lock);
+		__atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+		pthread_cond_broadcast(cond);
+		pthread_mutex_unlock(&channel->lock);
+	}
+}
+
+//wait until ready() or close
+static void byte_park(byte_channel_t* channel, int* waiting, pthread_cond_t* cond,
+		bool (*ready)(byte_channel_t*, size_t), size_t want) {
+	pthread_mutex_lock(&channel->lock);
+	__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+	while (!ready(channel, want) && !byte_closed(channel)) {
+		pthread_cond_wait(cond, &channel->lock);
+		__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+	}
+	pthread_mutex_unlock(&channel->lock);
+}
+
+//position a record of size bytes would start at, tail or the next wrap
+static size_t place(byte_channel_t* channel, size_t size) {
+	size_t to_end = channel->mask + 1 - (channel->tail & channel->mask);
+	return (size <= to_end) ? channel->tail : channel->tail + to_end;
+}
+
+//true if a record of size bytes fits, reloading head only if the cached copy is short
+static bool byte_has_space(byte_channel_t* channel, size_t size) {
+	size_t end = place(channel, size) + size;
+	if (end - channel->head_cache > channel->mask + 1) {
+		channel->head_cache = __atomic_load_n(&channel->head, __ATOMIC_SEQ_CST);
+	}
+	return end - channel->head_cache <= channel->mask + 1;
+}
+
+//true if a record is committed, reloading tail only if the cached copy is short
+static bool byte_has_data(byte_channel_t* channel, size_t unused) {
+	(void)unused;
+	if (channel->tail_cache == channel->head) {
+		channel->tail_cache = __atomic_load_n(&channel->tail, __ATOMIC_SEQ_CST);
+	}
+	return channel->tail_cache != channel->head;
+}
+
+// Creates a byte channel with a ring of at least capacity bytes, rounded up to a power of two
+// Messages can be up to about half the ring
+// Returns NULL if capacity is below 64 bytes or the ring cannot be allocated
+byte_channel_t* byte_channel_create(size_t capacity) {
+	if (capacity < 64 || capacity > ((size_t)-1 >> 1) + 1) {
+		return NULL;
+	}
+	size_t ring_size = 64;
+	while (ring_size < capacity) {
+		ring_size <<= 1;
+	}
+	byte_channel_t* channel = aligned_alloc(CACHE_LINE, sizeof(byte_channel_t));
+	if (!channel) {
+		return NULL;
+	}
+	memset(channel, 0, sizeof(byte_channel_t));
+	channel->data = aligned_alloc(CACHE_LINE, ring_size);
+	if (!channel->data) {
+		free(channel);
+		return NULL;
+	}
+	channel->mask = ring_size - 1;
+	channel->max_len = ring_size / 2 - HEADER;
+	pthread_mutex_init(&channel->lock, NULL);
+	pthread_cond_init(&channel->open, NULL);
+	pthread_cond_init(&channel->recv, NULL);
+	return channel;
+}
+
+static enum channel_status try_reserve(byte_channel_t* channel, size_t len, void** region) {
+	if (byte_closed(channel)) {
+		return CLOSED_ERROR;
+	}
+	size_t size = record_size(len);
+	if (!byte_has_space(channel, size)) {
+		return CHANNEL_FULL;
+	}
+	channel->reserved = place(channel, size);
+	channel->reserved_len = len;
+	*region = header_at(channel, channel->reserved) + 1;
+	return SUCCESS;
+}
+
+static enum channel_status reserve_check(byte_channel_t* channel, size_t len, void** region) {
+	if (!channel || !region || len == 0 || len > channel->max_len || channel->reserved_len != 0) {
+		return GENERIC_ERROR;
+	}
+	return SUCCESS;
+}
+
+// Reserves len bytes at the end of the ring and stores a pointer to them in region
+// The caller writes the message in place and publishes it with byte_channel_commit
+// This is a blocking call i.e., the function waits till the ring has room for len bytes
+// Returns SUCCESS for a successful reservation,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if len is too large for the ring, a reservation is already open, or on any other error
+enum channel_status byte_channel_reserve(byte_channel_t* channel, size_t len, void** region) {
+	enum channel_status status = reserve_check(channel, len, region);
+	if (status != SUCCESS) {
+		return status;
+	}
+	while ((status = try_reserve(channel, len, region)) == CHANNEL_FULL) {
+		byte_park(channel, &channel->send_waiting, &channel->open, byte_has_space, record_size(len));
+	}
+	return status;
+}
+
+// Reserves len bytes like byte_channel_reserve
+// This is a non-blocking call i.e., the function simply returns if the ring has no room
+// Returns SUCCESS for a successful reservation,
+// CHANNEL_FULL if the ring has no room for len bytes,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if len is too large for the ring, a reservation is already open, or on any other error
+enum channel_status byte_channel_non_blocking_reserve(byte_channel_t* channel, size_t len, void** region) {
+	enum channel_status status = reserve_check(channel, len, region);
+	if (status != SUCCESS) {
+		return status;
+	}
+	return try_reserve(channel, len, region);
+}
+
+// Publishes the first len bytes of the open reservation as one message, len may be less than was reserved
+// Returns SUCCESS for a successful commit, and
+// GENERIC_ERROR if nothing is reserved or len is larger than the reservation
+enum channel_status byte_channel_commit(byte_channel_t* channel, size_t len) {
+	if (!channel || channel->reserved_len == 0 || len > channel->reserved_len) {
+		return GENERIC_ERROR;
+	}
+	if (channel->reserved != channel->tail) {
+		*header_at(channel, channel->tail) = WRAP;
+	}
+	*header_at(channel, channel->reserved) = len;
+	//a shorter commit gives back the unused tail of the reservation
+	__atomic_store_n(&channel->tail, channel->reserved + record_size(len), __ATOMIC_SEQ_CST);
+	channel->reserved_len = 0;
+	byte_wake(channel, &channel->recv_waiting, &channel->recv);
+	return SUCCESS;
+}
+
+static enum channel_status try_peek(byte_channel_t* channel, void** region, size_t* len) {
+	if (!byte_has_data(channel, 0)) {
+		//drained, same as the locked channel
+		return byte_closed(channel) ? CLOSED_ERROR : CHANNEL_EMPTY;
+	}
+	size_t* header = header_at(channel, channel->head);
+	if (*header == WRAP) {
+		//skip the padding, the next record starts the ring and is already committed
+		size_t to_end = channel->mask + 1 - (channel->head & channel->mask);
+		__atomic_store_n(&channel->head, channel->head + to_end, __ATOMIC_SEQ_CST);
+		header = header_at(channel, channel->head);
+	}
+	*len = *header;
+	*region = header + 1;
+	channel->peeked = record_size(*len);
+	return SUCCESS;
+}
+
+static enum channel_status peek_check(byte_channel_t* channel, void** region, size_t* len) {
+	if (!channel || !region || !len || channel->peeked != 0) {
+		return GENERIC_ERROR;
+	}
+	return SUCCESS;
+}
+
+// Stores a pointer to the oldest message in region and its length in len, without copying it
+// The message stays in the ring until byte_channel_release
+// This is a blocking call i.e., the function waits till the ring has a message
+// Returns SUCCESS for a successful peek,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR if a message is already peeked, or on any other error
+enum channel_status byte_channel_peek(byte_channel_t* channel, void** region, size_t* len) {
+	enum channel_status status = peek_check(channel, region, len);
+	if (status != SUCCESS) {
+		return status;
+	}
+	while ((status = try_peek(channel, region, len)) == CHANNEL_EMPTY) {
+		byte_park(channel, &channel->recv_waiting, &channel->recv, byte_has_data, 0);
+	}
+	return status;
+}
+
+// Peeks at the oldest message like byte_channel_peek
+// This is a non-blocking call i.e., the function simply returns if the ring is empty
+// Returns SUCCESS for a successful peek,
+// CHANNEL_EMPTY if the ring is empty,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR if a message is already peeked, or on any other error
+enum channel_status byte_channel_non_blocking_peek(byte_channel_t* channel, void** region, size_t* len) {
+	enum channel_status status = peek_check(channel, region, len);
+	if (status != SUCCESS) {
+		return status;
+	}
+	return try_peek(channel, region, len);
+}
+
+// Frees the ring space of the peeked message, its region must not be used afterwards
+// Returns SUCCESS for a successful release, and
+// GENERIC_ERROR if nothing is peeked
+enum channel_status byte_channel_release(byte_channel_t* channel) {
+	if (!channel || channel->peeked == 0) {
+		return GENERIC_ERROR;
+	}
+	__atomic_store_n(&channel->head, channel->head + channel->peeked, __ATOMIC_SEQ_CST);
+	channel->peeked = 0;
+	byte_wake(channel, &channel->send_waiting, &channel->open);
+	return SUCCESS;
+}
+
+// Closes the byte channel and wakes the blocked reserve and peek calls
+// Messages already committed can still be peeked before CLOSED_ERROR is returned
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status byte_channel_close(byte_channel_t* channel) {
+	if (!channel) {
+		return GENERIC_ERROR;
+	}
+	pthread_mutex_lock(&channel->lock);
+	if (channel->closed) {
+		pthread_mutex_unlock(&channel->lock);
+		return CLOSED_ERROR;
+	}
+	__atomic_store_n(&channel->closed, true, __ATOMIC_SEQ_CST);
+	pthread_cond_broadcast(&channel->open);
+	pthread_cond_broadcast(&channel->recv);
+	pthread_mutex_unlock(&channel->lock);
+	return SUCCESS;
+}
+
+// Frees all the memory allocated to the byte channel
+// Returns SUCCESS if destroy is successful,
+// DESTROY_ERROR if byte_channel_destroy is called on an open channel, and
+// GENERIC_ERROR in any other error case
+enum channel_status byte_channel_destroy(byte_channel_t* channel) {
+	if (!channel) {
+		return GENERIC_ERROR;
+	}
+	if (!channel->closed) {
+		return DESTROY_ERROR;
+	}
+	pthread_mutex_destroy(&channel->lock);
+	pthread_cond_destroy(&channel->open);
+	pthread_cond_destroy(&channel->recv);
+	free(channel->data);
+	free(channel);
+	return SUCCESS;
+}
@@ -0,0 +1,95 @@
+#ifndef BYTE_CHANNEL_H
+#define BYTE_CHANNEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "channel.h"
+
+// Defines a channel of variable-length byte messages kept in one contiguous ring
+// A message is an 8-byte length header followed by its bytes, padded to 8 bytes, so
+// message contents are 8-byte aligned. A message that would cross the end of the ring
+// is placed at the start instead, after a wrap header that fills the rest.
+// Like CHANNEL_SPSC, one thread reserves and one thread peeks at a time.
+typedef struct {
+    unsigned char* data;
+    size_t mask;                          // capacity - 1, the capacity is a power of two
+    size_t max_len;                       // largest message, so one always fits an empty ring
+    _Alignas(CACHE_LINE) size_t tail;     // end of the committed messages, written by the producer
+    size_t head_cache;                    // producer's last read of head
+    size_t reserved;                      // position of the reserved message, tail if it follows on
+    size_t reserved_len;                  // bytes reserved, 0 if nothing is reserved
+    _Alignas(CACHE_LINE) size_t head;     // start of the oldest message, written by the consumer
+    size_t tail_cache;                    // consumer's last read of tail
+    size_t peeked;                        // ring bytes of the peeked message, 0 if nothing is peeked
+    _Alignas(CACHE_LINE) pthread_mutex_t lock; // only used to park on a full or empty ring
+    pthread_cond_t open;
+    pthread_cond_t recv;
+    int send_waiting;
+    int recv_waiting;
+    bool closed;
+} byte_channel_t;
+
+// Creates a byte channel with a ring of at least capacity bytes, rounded up to a power of two
+// Messages can be up to about half the ring
+// Returns NULL if capacity is below 64 bytes or the ring cannot be allocated
+byte_channel_t* byte_channel_create(size_t capacity);
+
+// Reserves len bytes at the end of the ring and stores a pointer to them in region
+// The caller writes the message in place and publishes it with byte_channel_commit
+// This is a blocking call i.e., the function waits till the ring has room for len bytes
+// Returns SUCCESS for a successful reservation,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if len is too large for the ring, a reservation is already open, or on any other error
+enum channel_status byte_channel_reserve(byte_channel_t* channel, size_t len, void** region);
+
+// Reserves len bytes like byte_channel_reserve
+// This is a non-blocking call i.e., the function simply returns if the ring has no room
+// Returns SUCCESS for a successful reservation,
+// CHANNEL_FULL if the ring has no room for len bytes,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if len is too large for the ring, a reservation is already open, or on any other error
+enum channel_status byte_channel_non_blocking_reserve(byte_channel_t* channel, size_t len, void** region);
+
+// Publishes the first len bytes of the open reservation as one message, len may be less than was reserved
+// Returns SUCCESS for a successful commit, and
+// GENERIC_ERROR if nothing is reserved or len is larger than the reservation
+enum channel_status byte_channel_commit(byte_channel_t* channel, size_t len);
+
+// Stores a pointer to the oldest message in region and its length in len, without copying it
+// The message stays in the ring until byte_channel_release
+// This is a blocking call i.e., the function waits till the ring has a message
+// Returns SUCCESS for a successful peek,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR if a message is already peeked, or on any other error
+enum channel_status byte_channel_peek(byte_channel_t* channel, void** region, size_t* len);
+
+// Peeks at the oldest message like byte_channel_peek
+// This is a non-blocking call i.e., the function simply returns if the ring is empty
+// Returns SUCCESS for a successful peek,
+// CHANNEL_EMPTY if the ring is empty,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR if a message is already peeked, or on any other error
+enum channel_status byte_channel_non_blocking_peek(byte_channel_t* channel, void** region, size_t* len);
+
+// Frees the ring space of the peeked message, its region must not be used afterwards
+// Returns SUCCESS for a successful release, and
+// GENERIC_ERROR if nothing is peeked
+enum channel_status byte_channel_release(byte_channel_t* channel);
+
+// Closes the byte channel and wakes the blocked reserve and peek calls
+// Messages already committed can still be peeked before CLOSED_ERROR is returned
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status byte_channel_close(byte_channel_t* channel);
+
+// Frees all the memory allocated to the byte channel
+// Returns SUCCESS if destroy is successful,
+// DESTROY_ERROR if byte_channel_destroy is called on an open channel, and
+// GENERIC_ERROR in any other error case
+enum channel_status byte_channel_destroy(byte_channel_t* channel);
+
+#endif // BYTE_CHANNEL_H
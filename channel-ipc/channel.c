@@ -1,4 +1,17 @@
 #include "channel.h"
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+//adaptive wait tuning, see adaptive_spin
+#define SPIN_START 128
+#define SPIN_MIN 16
+#define SPIN_MAX 8192
+#define YIELD_ROUNDS 4
+#define WAKE_WANTED 1 //waiting bit, the next publish has to wake a parked thread
+#define PARKED_ONE 2  //waiting counts the parked threads above that bit
 //pthread library functions
 //for my own reference to remeber helpful library functions i havent used before
 //special emphasis on pthread_cond... functions as our lock is a struct
@@ -12,17 +25,45 @@
 //pthread_cond_broadcast
 
 // Creates a new channel with the provided size and returns it to the caller
+// A channel of size 0 is unbuffered: each send waits for a receiver and hands its data over directly
 channel_t* channel_create(size_t size) {
+	return channel_create_mode(size, CHANNEL_LOCKED);
+}
+
+// Creates a new channel like channel_create, using the given implementation
+// A CHANNEL_SPSC channel must have one thread sending and one thread receiving at a time
+// Its buffer is rounded up to a power of two, but it still holds at most size messages
+// A CHANNEL_UNBOUNDED channel has no fixed capacity, size is a soft limit on the messages it queues
+// Sends block, or return CHANNEL_FULL, while it holds size or more messages, and a size of 0 means no limit
+// Concurrent senders can overshoot the limit by one message each
+// Only CHANNEL_LOCKED channels can be used with channel_select
+// Returns NULL for a CHANNEL_SPSC or CHANNEL_MPMC channel of size 0
+channel_t* channel_create_mode(size_t size, enum channel_mode mode) {
+	if ((mode == CHANNEL_SPSC || mode == CHANNEL_MPMC) && size == 0) {
+		return NULL;
+	}
 	//create channel
-	//malloc size of struct channel_t
+	//aligned, so the MPMC positions really get cache lines of their own
 	//check malloc success
-	channel_t* channel = malloc(sizeof(channel_t));
+	channel_t* channel = aligned_alloc(CACHE_LINE, sizeof(channel_t));
 	if (!channel) {
 		return NULL;
 	}
 	//create channel buffer
 	//check success, else free and return
-	channel->buffer = buffer_create(size);
+	//SPSC indexes the buffer with a mask
+	size_t slots = size;
+	if (mode == CHANNEL_SPSC) {
+		slots = 1;
+		while (slots < size) {
+			slots *= 2;
+		}
+	}
+	//UNBOUNDED keeps its messages in segments
+	if (mode == CHANNEL_UNBOUNDED) {
+		slots = 0;
+	}
+	channel->buffer = buffer_create(slots);
 	if (!channel->buffer) {
 		free(channel);
 		return NULL;
@@ -32,9 +73,675 @@ channel_t* channel_create(size_t size) {
 	pthread_cond_init(&channel->open, NULL);
 	pthread_cond_init(&channel->recv, NULL);
 	channel->closed = false;
+	channel->mode = mode;
+	channel->head = 0;
+	channel->tail = 0;
+	channel->send_waiting = 0;
+	channel->recv_waiting = 0;
+	channel->send_seq = 0;
+	channel->recv_seq = 0;
+	channel->adaptive = true;
+	channel->spin_limit = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? SPIN_START : 0;
+	channel->slots = NULL;
+	channel->ring = NULL;
+	channel->queue = NULL;
+	channel->senders = (handoff_queue_t){NULL, NULL};
+	channel->receivers = (handoff_queue_t){NULL, NULL};
+	channel->waiters = list_create();
+	if (!channel->waiters) {
+		buffer_free(channel->buffer);
+		free(channel);
+		return NULL;
+	}
+	if (mode == CHANNEL_MPMC) {
+		channel->slots = malloc(size * sizeof(mpmc_slot_t));
+		if (!channel->slots) {
+			list_destroy(channel->waiters);
+			buffer_free(channel->buffer);
+			free(channel);
+			return NULL;
+		}
+		for (size_t i = 0; i < size; i++) {
+			channel->slots[i].seq = 2 * i;
+		}
+	}
+	if (mode == CHANNEL_SPSC) {
+		channel->ring = aligned_alloc(CACHE_LINE, sizeof(spsc_ring_t));
+		if (!channel->ring) {
+			list_destroy(channel->waiters);
+			buffer_free(channel->buffer);
+			free(channel);
+			return NULL;
+		}
+		memset(channel->ring, 0, sizeof(spsc_ring_t));
+		channel->ring->mask = slots - 1;
+		channel->ring->capacity = size;
+	}
+	if (mode == CHANNEL_UNBOUNDED) {
+		channel->queue = aligned_alloc(CACHE_LINE, sizeof(unbounded_queue_t));
+		segment_t* first = calloc(1, sizeof(segment_t));
+		if (!channel->queue || !first) {
+			free(channel->queue);
+			free(first);
+			list_destroy(channel->waiters);
+			buffer_free(channel->buffer);
+			free(channel);
+			return NULL;
+		}
+		memset(channel->queue, 0, sizeof(unbounded_queue_t));
+		channel->queue->head_segment = first;
+		channel->queue->tail_segment = first;
+		channel->queue->limit = size;
+	}
 	return channel;
 }
 
+//a channel_select blocked until dir is possible on a channel
+//registered in channel->waiters while the select sleeps on wake
+typedef struct {
+	sem_t* wake;
+	enum direction dir;
+} select_waiter_t;
+
+//wake the selects waiting for dir, lock must be held
+static void wake_selects(channel_t* channel, enum direction dir) {
+	for (list_node_t* node = list_head(channel->waiters); node; node = list_next(node)) {
+		select_waiter_t* waiter = node->data;
+		if (waiter->dir == dir) {
+			sem_post(waiter->wake);
+		}
+	}
+}
+
+//unbuffered (size 0) locked channels
+//there is no buffer space, so a message goes straight from a sender to a
+//receiver parked on the other queue, or the reverse, all under the lock
+//the parked side sleeps on its own semaphore without the lock, so the woken
+//thread runs straight on and each message costs one wakeup
+
+static void handoff_push(handoff_queue_t* queue, handoff_t* handoff) {
+	handoff->next = NULL;
+	if (queue->tail) {
+		queue->tail->next = handoff;
+	} else {
+		queue->head = handoff;
+	}
+	queue->tail = handoff;
+}
+
+static handoff_t* handoff_pop(handoff_queue_t* queue) {
+	handoff_t* handoff = queue->head;
+	if (handoff) {
+		queue->head = handoff->next;
+		if (!queue->head) {
+			queue->tail = NULL;
+		}
+	}
+	return handoff;
+}
+
+//wake every parked thread, they see closed and return
+//each record is popped before its post, a woken thread's record lives on its
+//stack and is gone once it returns
+static void handoff_close(handoff_queue_t* queue) {
+	handoff_t* handoff;
+	while ((handoff = handoff_pop(queue)) != NULL) {
+		sem_post(&handoff->wake);
+	}
+}
+
+//park on queue until a peer takes or fills in data, or the channel closes
+//dir is the direction a select could now complete in
+//lock must be held, it is released before sleeping
+//the record is popped exactly once, by a peer or by close, so there is one post
+static enum channel_status handoff_park(channel_t* channel, handoff_queue_t* queue,
+		enum direction dir, void** data) {
+	handoff_t self;
+	self.data = *data;
+	self.done = false;
+	sem_init(&self.wake, 0, 0);
+	handoff_push(queue, &self);
+	wake_selects(channel, dir);
+	pthread_mutex_unlock(&channel->lock);
+	sem_wait(&self.wake);
+	sem_destroy(&self.wake);
+	*data = self.data;
+	return self.done ? SUCCESS : CLOSED_ERROR;
+}
+
+//add data to the buffer, or hand it to a parked receiver, lock must be held
+static bool locked_add(channel_t* channel, void* data) {
+	if (buffer_add(channel->buffer, data) == BUFFER_SUCCESS) {
+		return true;
+	}
+	handoff_t* receiver = handoff_pop(&channel->receivers);
+	if (!receiver) {
+		return false;
+	}
+	receiver->data = data;
+	receiver->done = true;
+	sem_post(&receiver->wake);
+	return true;
+}
+
+//remove data from the buffer, or take it from a parked sender, lock must be held
+static bool locked_remove(channel_t* channel, void** data) {
+	if (buffer_remove(channel->buffer, data) == BUFFER_SUCCESS) {
+		return true;
+	}
+	handoff_t* sender = handoff_pop(&channel->senders);
+	if (!sender) {
+		return false;
+	}
+	*data = sender->data;
+	sender->done = true;
+	sem_post(&sender->wake);
+	return true;
+}
+
+static bool unbuffered(channel_t* channel) {
+	return channel->mode == CHANNEL_LOCKED && buffer_capacity(channel->buffer) == 0;
+}
+
+//adaptive wait for the SPSC, MPMC and UNBOUNDED modes
+//a blocked thread spins with a pause, rechecking the ring, for up to
+//spin_limit rounds, then yields a few times, and only then sleeps on a futex
+//a spin that sees the ring ready pulls spin_limit toward twice the rounds it
+//took, one that runs out halves it, so it settles on the usual wait
+//with one CPU the other side cannot run while we spin, and a yield only hands
+//the CPU to a peer that may stay busy for a whole time slice, so we park at once
+//the sleeping side sets a waiting flag before its last check, the waking side
+//bumps the futex word and only makes the wake syscall if the flag is set
+//CHANNEL_LOCKED keeps its condition variables: its waiters sleep holding the
+//channel lock, which every send, receive and select registration takes, so
+//spinning there would only spin on that lock
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static void futex_wait(uint32_t* word, uint32_t seen) {
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t* word, int count) {
+	__atomic_add_fetch(word, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static bool spsc_closed(channel_t* channel);
+
+//returns true once ready() or close is seen, false if the caller should sleep
+static bool adaptive_spin(channel_t* channel, bool (*ready)(channel_t*)) {
+	uint32_t limit = __atomic_load_n(&channel->spin_limit, __ATOMIC_RELAXED);
+	if (!channel->adaptive || limit == 0) {
+		return false;
+	}
+	for (uint32_t i = 0; i < limit; i++) {
+		if (ready(channel) || spsc_closed(channel)) {
+			uint32_t target = (2 * i < SPIN_MIN) ? SPIN_MIN : 2 * i;
+			target = (target > SPIN_MAX) ? SPIN_MAX : target;
+			//every spinning thread reads the limit, only dirty its line on a change
+			uint32_t next = (limit * 7 + target) / 8;
+			if (next != limit) {
+				__atomic_store_n(&channel->spin_limit, next, __ATOMIC_RELAXED);
+			}
+			return true;
+		}
+		cpu_relax();
+	}
+	uint32_t next = (limit / 2 < SPIN_MIN) ? SPIN_MIN : limit / 2;
+	if (next != limit) {
+		__atomic_store_n(&channel->spin_limit, next, __ATOMIC_RELAXED);
+	}
+	for (int i = 0; i < YIELD_ROUNDS; i++) {
+		sched_yield();
+		if (ready(channel) || spsc_closed(channel)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//wake one thread parked on word, if one asked for it
+//the caller published with a seq_cst store, so either this load sees the flag
+//or the parking side's recheck sees what was published
+//clearing the flag keeps the rest of a burst from making the syscall again,
+//close wakes every parked thread itself
+static void wait_wake(int* waiting, uint32_t* word) {
+	if ((__atomic_load_n(waiting, __ATOMIC_SEQ_CST) & WAKE_WANTED)
+		&& (__atomic_fetch_and(waiting, ~WAKE_WANTED, __ATOMIC_SEQ_CST) & WAKE_WANTED)) {
+		futex_wake(word, 1);
+	}
+}
+
+//wait until ready() or close
+//the futex word is read before the flag is set, so a wake after the recheck
+//changes it and the futex wait returns straight away
+//publishes made while the flag was clear woke nobody, so a woken thread passes
+//the wake on as it leaves if others are still parked, and the last one out
+//clears the flag so the next publish skips the syscall
+static void wait_park(channel_t* channel, int* waiting, uint32_t* word,
+		bool (*ready)(channel_t*)) {
+	if (adaptive_spin(channel, ready)) {
+		return;
+	}
+	bool slept = false;
+	__atomic_add_fetch(waiting, PARKED_ONE, __ATOMIC_SEQ_CST);
+	while (true) {
+		uint32_t seen = __atomic_load_n(word, __ATOMIC_SEQ_CST);
+		__atomic_or_fetch(waiting, WAKE_WANTED, __ATOMIC_SEQ_CST);
+		if (ready(channel) || spsc_closed(channel)) {
+			break;
+		}
+		futex_wait(word, seen);
+		slept = true;
+	}
+	//one update, so a thread parking meanwhile keeps the flag it set
+	int old = __atomic_load_n(waiting, __ATOMIC_SEQ_CST);
+	int left;
+	do {
+		left = old - PARKED_ONE;
+		if (left < PARKED_ONE) {
+			left = 0;
+		}
+	} while (!__atomic_compare_exchange_n(waiting, &old, left, true,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+	if (slept && left != 0) {
+		futex_wake(word, 1);
+	}
+}
+
+// Turns the spin-then-yield phase before parking on or off for a CHANNEL_SPSC, CHANNEL_MPMC or CHANNEL_UNBOUNDED channel
+// It is on by default, a blocked thread then only sleeps once the wait outlasts the tuned spin
+void channel_set_adaptive_wait(channel_t* channel, bool enable) {
+	if (channel) {
+		channel->adaptive = enable;
+	}
+}
+
+//SPSC mode
+//the sender is the only writer of tail and the receiver the only writer of head,
+//so each side publishes its index with an atomic store and reads the other's
+//with an acquire load, no lock needed
+//each side first checks its cached copy of the other's index and only
+//reloads it from the other cache line when the copy says full or empty
+//a full or empty ring falls back to the adaptive wait above: the parking side
+//sets its waiting flag and rechecks, the other side checks the flag after
+//publishing and only then makes the wake syscall
+
+static bool spsc_closed(channel_t* channel) {
+	return __atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE);
+}
+
+//free positions for the sender, reloading head only if the cached copy is short
+static size_t spsc_space(spsc_ring_t* ring, size_t want) {
+	size_t space = ring->capacity - (ring->tail - ring->head_cache);
+	if (space < want) {
+		ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		space = ring->capacity - (ring->tail - ring->head_cache);
+	}
+	return space;
+}
+
+//filled positions for the receiver, reloading tail only if the cached copy is short
+static size_t spsc_ready(spsc_ring_t* ring, size_t want) {
+	size_t ready = ring->tail_cache - ring->head;
+	if (ready < want) {
+		ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		ready = ring->tail_cache - ring->head;
+	}
+	return ready;
+}
+
+static enum channel_status spsc_try_send(channel_t* channel, void* data) {
+	if (spsc_closed(channel)) {
+		return CLOSED_ERROR;
+	}
+	spsc_ring_t* ring = channel->ring;
+	if (spsc_space(ring, 1) == 0) {
+		return CHANNEL_FULL;
+	}
+	channel->buffer->data[ring->tail & ring->mask] = data;
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_SEQ_CST);
+	wait_wake(&channel->recv_waiting, &channel->recv_seq);
+	return SUCCESS;
+}
+
+static enum channel_status spsc_try_receive(channel_t* channel, void** data) {
+	spsc_ring_t* ring = channel->ring;
+	if (spsc_ready(ring, 1) == 0) {
+		//drained, same as the locked channel
+		return spsc_closed(channel) ? CLOSED_ERROR : CHANNEL_EMPTY;
+	}
+	*data = channel->buffer->data[ring->head & ring->mask];
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+	wait_wake(&channel->send_waiting, &channel->send_seq);
+	return SUCCESS;
+}
+
+static bool spsc_has_space(channel_t* channel) {
+	spsc_ring_t* ring = channel->ring;
+	return ring->tail - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) < ring->capacity;
+}
+
+static bool spsc_has_data(channel_t* channel) {
+	spsc_ring_t* ring = channel->ring;
+	return __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) != ring->head;
+}
+
+static enum channel_status spsc_send(channel_t* channel, void* data) {
+	enum channel_status status;
+	while ((status = spsc_try_send(channel, data)) == CHANNEL_FULL) {
+		wait_park(channel, &channel->send_waiting, &channel->send_seq, spsc_has_space);
+	}
+	return status;
+}
+
+static enum channel_status spsc_receive(channel_t* channel, void** data) {
+	enum channel_status status;
+	while ((status = spsc_try_receive(channel, data)) == CHANNEL_EMPTY) {
+		wait_park(channel, &channel->recv_waiting, &channel->recv_seq, spsc_has_data);
+	}
+	return status;
+}
+
+//MPMC mode, Vyukov's bounded queue
+//a sender claims position tail with a CAS once the slot's seq says it is free
+//for that position, writes data and marks the slot filled; a receiver claims
+//head once the slot is filled and frees it for position head + capacity.
+//seq counts in halves so a queue of capacity 1 can tell a slot filled at
+//position p from one free for p + 1
+//a full or empty queue parks with the adaptive wait, like SPSC
+
+static enum channel_status mpmc_try_send(channel_t* channel, void* data) {
+	if (spsc_closed(channel)) {
+		return CLOSED_ERROR;
+	}
+	size_t capacity = channel->buffer->capacity;
+	size_t pos = __atomic_load_n(&channel->tail, __ATOMIC_RELAXED);
+	while (true) {
+		mpmc_slot_t* slot = &channel->slots[pos % capacity];
+		size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == 2 * pos) {
+			if (__atomic_compare_exchange_n(&channel->tail, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				slot->data = data;
+				__atomic_store_n(&slot->seq, 2 * pos + 1, __ATOMIC_SEQ_CST);
+				wait_wake(&channel->recv_waiting, &channel->recv_seq);
+				return SUCCESS;
+			}
+		} else if (seq < 2 * pos) {
+			//slot still holds the message from a lap ago
+			return CHANNEL_FULL;
+		} else {
+			pos = __atomic_load_n(&channel->tail, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static enum channel_status mpmc_try_receive(channel_t* channel, void** data) {
+	size_t capacity = channel->buffer->capacity;
+	size_t pos = __atomic_load_n(&channel->head, __ATOMIC_RELAXED);
+	while (true) {
+		mpmc_slot_t* slot = &channel->slots[pos % capacity];
+		size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == 2 * pos + 1) {
+			if (__atomic_compare_exchange_n(&channel->head, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				*data = slot->data;
+				__atomic_store_n(&slot->seq, 2 * (pos + capacity), __ATOMIC_SEQ_CST);
+				wait_wake(&channel->send_waiting, &channel->send_seq);
+				return SUCCESS;
+			}
+		} else if (seq < 2 * pos + 1) {
+			//drained, same as the locked channel
+			if (!spsc_closed(channel)) {
+				return CHANNEL_EMPTY;
+			}
+			if (pos == __atomic_load_n(&channel->tail, __ATOMIC_SEQ_CST)) {
+				return CLOSED_ERROR;
+			}
+			//a sender claimed the slot before the close and is still writing it
+			sched_yield();
+			pos = __atomic_load_n(&channel->head, __ATOMIC_RELAXED);
+		} else {
+			pos = __atomic_load_n(&channel->head, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static bool mpmc_has_space(channel_t* channel) {
+	size_t pos = __atomic_load_n(&channel->tail, __ATOMIC_SEQ_CST);
+	mpmc_slot_t* slot = &channel->slots[pos % channel->buffer->capacity];
+	return __atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) >= 2 * pos;
+}
+
+static bool mpmc_has_data(channel_t* channel) {
+	size_t pos = __atomic_load_n(&channel->head, __ATOMIC_SEQ_CST);
+	mpmc_slot_t* slot = &channel->slots[pos % channel->buffer->capacity];
+	return __atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) >= 2 * pos + 1;
+}
+
+static enum channel_status mpmc_send(channel_t* channel, void* data) {
+	enum channel_status status;
+	while ((status = mpmc_try_send(channel, data)) == CHANNEL_FULL) {
+		wait_park(channel, &channel->send_waiting, &channel->send_seq, mpmc_has_space);
+	}
+	return status;
+}
+
+static enum channel_status mpmc_receive(channel_t* channel, void** data) {
+	enum channel_status status;
+	while ((status = mpmc_try_receive(channel, data)) == CHANNEL_EMPTY) {
+		wait_park(channel, &channel->recv_waiting, &channel->recv_seq, mpmc_has_data);
+	}
+	return status;
+}
+
+//UNBOUNDED mode, a queue of linked segments
+//head and tail are positions that only grow; position p is slot p % SEGMENT_LAP
+//of its segment and the last position of each lap marks a segment change
+//a sender claims tail with a CAS and the one that claims a segment's last slot
+//links in the next segment, so growing takes no lock; senders that reach the
+//marker wait out that one step. A receiver claims head the same way and the
+//one that claims the last slot moves head onto the next segment
+//a CAS that succeeds proves the position did not move since it was read, so
+//the segment read just after it is still that position's segment
+//a segment is reused once every slot is read: the last slot's receiver walks
+//the slots, and marks one still being read so its receiver carries on the walk
+//spent segments go to a small array freelist that is taken from and refilled
+//with atomic exchanges, so it has no ABA problem, and any extra are freed
+//with a soft limit a send finds the queue full at limit messages and parks
+//like MPMC until receivers drain below it
+
+#define SLOT_WRITTEN 1
+#define SLOT_READ 2
+#define SLOT_RECYCLE 4
+
+static segment_t* segment_get(unbounded_queue_t* queue) {
+	for (int i = 0; i < SEGMENT_FREELIST; i++) {
+		segment_t* segment = __atomic_exchange_n(&queue->freelist[i], NULL, __ATOMIC_SEQ_CST);
+		if (segment) {
+			return segment;
+		}
+	}
+	return calloc(1, sizeof(segment_t));
+}
+
+static void segment_put(unbounded_queue_t* queue, segment_t* segment) {
+	memset(segment, 0, sizeof(segment_t));
+	for (int i = 0; i < SEGMENT_FREELIST; i++) {
+		segment_t* empty = NULL;
+		if (__atomic_compare_exchange_n(&queue->freelist[i], &empty, segment, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+			return;
+		}
+	}
+	free(segment);
+}
+
+//recycle segment once the slots from start on are read
+static void segment_release(unbounded_queue_t* queue, segment_t* segment, size_t start) {
+	//the last slot's receiver started the walk, so it does not need checking
+	for (size_t i = start; i < SEGMENT_SLOTS - 1; i++) {
+		int* state = &segment->slots[i].state;
+		if (!(__atomic_load_n(state, __ATOMIC_SEQ_CST) & SLOT_READ)
+			&& !(__atomic_fetch_or(state, SLOT_RECYCLE, __ATOMIC_SEQ_CST) & SLOT_READ)) {
+			return;
+		}
+	}
+	segment_put(queue, segment);
+}
+
+//messages queued, not counting the segment change positions
+static size_t unbounded_size(unbounded_queue_t* queue) {
+	size_t head = __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST);
+	size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+	return (tail - head) - (tail / SEGMENT_LAP - head / SEGMENT_LAP);
+}
+
+static enum channel_status unbounded_try_send(channel_t* channel, void* data) {
+	if (spsc_closed(channel)) {
+		return CLOSED_ERROR;
+	}
+	unbounded_queue_t* queue = channel->queue;
+	if (queue->limit && unbounded_size(queue) >= queue->limit) {
+		return CHANNEL_FULL;
+	}
+	segment_t* next = NULL;
+	size_t pos = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+	segment_t* segment = __atomic_load_n(&queue->tail_segment, __ATOMIC_SEQ_CST);
+	while (true) {
+		size_t offset = pos % SEGMENT_LAP;
+		if (offset == SEGMENT_SLOTS) {
+			//another sender is linking the next segment
+			sched_yield();
+			pos = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+			segment = __atomic_load_n(&queue->tail_segment, __ATOMIC_SEQ_CST);
+			continue;
+		}
+		//get the next segment before claiming the last slot, so the link step is short
+		if (offset == SEGMENT_SLOTS - 1 && !next) {
+			next = segment_get(queue);
+			if (!next) {
+				return GENERIC_ERROR;
+			}
+		}
+		if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, true,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+			if (offset == SEGMENT_SLOTS - 1) {
+				__atomic_store_n(&queue->tail_segment, next, __ATOMIC_SEQ_CST);
+				__atomic_store_n(&queue->tail, pos + 2, __ATOMIC_SEQ_CST);
+				__atomic_store_n(&segment->next, next, __ATOMIC_SEQ_CST);
+				next = NULL;
+			}
+			segment->slots[offset].data = data;
+			__atomic_fetch_or(&segment->slots[offset].state, SLOT_WRITTEN, __ATOMIC_SEQ_CST);
+			if (next) {
+				//tail moved on past the last slot before this sender claimed it
+				segment_put(queue, next);
+			}
+			wait_wake(&channel->recv_waiting, &channel->recv_seq);
+			return SUCCESS;
+		}
+		segment = __atomic_load_n(&queue->tail_segment, __ATOMIC_SEQ_CST);
+	}
+}
+
+static enum channel_status unbounded_try_receive(channel_t* channel, void** data) {
+	unbounded_queue_t* queue = channel->queue;
+	size_t pos = __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST);
+	segment_t* segment = __atomic_load_n(&queue->head_segment, __ATOMIC_SEQ_CST);
+	while (true) {
+		size_t offset = pos % SEGMENT_LAP;
+		if (offset == SEGMENT_SLOTS) {
+			//another receiver is moving head to the next segment
+			sched_yield();
+			pos = __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST);
+			segment = __atomic_load_n(&queue->head_segment, __ATOMIC_SEQ_CST);
+			continue;
+		}
+		if (pos == __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST)) {
+			//drained, same as the locked channel
+			return spsc_closed(channel) ? CLOSED_ERROR : CHANNEL_EMPTY;
+		}
+		if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, true,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+			bool last = (offset == SEGMENT_SLOTS - 1);
+			if (last) {
+				segment_t* next;
+				while (!(next = __atomic_load_n(&segment->next, __ATOMIC_SEQ_CST))) {
+					sched_yield();
+				}
+				__atomic_store_n(&queue->head_segment, next, __ATOMIC_SEQ_CST);
+				__atomic_store_n(&queue->head, pos + 2, __ATOMIC_SEQ_CST);
+			}
+			//the slot is claimed, its sender may still be writing it
+			int* state = &segment->slots[offset].state;
+			while (!(__atomic_load_n(state, __ATOMIC_SEQ_CST) & SLOT_WRITTEN)) {
+				sched_yield();
+			}
+			*data = segment->slots[offset].data;
+			if (last) {
+				segment_release(queue, segment, 0);
+			} else if (__atomic_fetch_or(state, SLOT_READ, __ATOMIC_SEQ_CST) & SLOT_RECYCLE) {
+				segment_release(queue, segment, offset + 1);
+			}
+			wait_wake(&channel->send_waiting, &channel->send_seq);
+			return SUCCESS;
+		}
+		segment = __atomic_load_n(&queue->head_segment, __ATOMIC_SEQ_CST);
+	}
+}
+
+static bool unbounded_has_space(channel_t* channel) {
+	unbounded_queue_t* queue = channel->queue;
+	return !queue->limit || unbounded_size(queue) < queue->limit;
+}
+
+static bool unbounded_has_data(channel_t* channel) {
+	unbounded_queue_t* queue = channel->queue;
+	return __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST)
+		!= __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+}
+
+static enum channel_status unbounded_send(channel_t* channel, void* data) {
+	enum channel_status status;
+	while ((status = unbounded_try_send(channel, data)) == CHANNEL_FULL) {
+		wait_park(channel, &channel->send_waiting, &channel->send_seq, unbounded_has_space);
+	}
+	return status;
+}
+
+static enum channel_status unbounded_receive(channel_t* channel, void** data) {
+	enum channel_status status;
+	while ((status = unbounded_try_receive(channel, data)) == CHANNEL_EMPTY) {
+		wait_park(channel, &channel->recv_waiting, &channel->recv_seq, unbounded_has_data);
+	}
+	return status;
+}
+
+static void unbounded_free(unbounded_queue_t* queue) {
+	if (!queue) {
+		return;
+	}
+	segment_t* segment = queue->head_segment;
+	while (segment) {
+		segment_t* next = segment->next;
+		free(segment);
+		segment = next;
+	}
+	for (int i = 0; i < SEGMENT_FREELIST; i++) {
+		free(queue->freelist[i]);
+	}
+	free(queue);
+}
+
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
@@ -46,12 +753,29 @@ enum channel_status channel_send(channel_t *channel, void* data) {
 	if (!channel) {
                 return GENERIC_ERROR;
         }
+	if (channel->mode == CHANNEL_SPSC) {
+		return spsc_send(channel, data);
+	}
+	if (channel->mode == CHANNEL_MPMC) {
+		return mpmc_send(channel, data);
+	}
+	if (channel->mode == CHANNEL_UNBOUNDED) {
+		return unbounded_send(channel, data);
+	}
         pthread_mutex_lock(&(channel)->lock);
         //channel closed, unlock CLOSED_ERROR
         if (channel->closed) {
                 pthread_mutex_unlock(&(channel)->lock);
                 return CLOSED_ERROR;
         }
+	//unbuffered, hand off to a parked receiver or park until one takes it
+	if (unbuffered(channel)) {
+		if (locked_add(channel, data)) {
+			pthread_mutex_unlock(&(channel)->lock);
+			return SUCCESS;
+		}
+		return handoff_park(channel, &channel->senders, RECV, &data);
+	}
         //try to add to buffer
 	//in while loop, if error dont return full, wait
 	//must continually check if channel closes
@@ -64,6 +788,7 @@ enum channel_status channel_send(channel_t *channel, void* data) {
 	}
         //wake thread and unlock
         pthread_cond_signal(&channel->recv);
+        wake_selects(channel, RECV);
         pthread_mutex_unlock(&(channel)->lock);
         return SUCCESS;
 }
@@ -80,7 +805,28 @@ enum channel_status channel_receive(channel_t* channel, void** data) {
 	if (!channel || !data) {
                 return GENERIC_ERROR;
         }
+	if (channel->mode == CHANNEL_SPSC) {
+		return spsc_receive(channel, data);
+	}
+	if (channel->mode == CHANNEL_MPMC) {
+		return mpmc_receive(channel, data);
+	}
+	if (channel->mode == CHANNEL_UNBOUNDED) {
+		return unbounded_receive(channel, data);
+	}
         pthread_mutex_lock(&(channel)->lock);
+	//unbuffered, take from a parked sender or park until one fills in data
+	if (unbuffered(channel)) {
+		if (channel->closed) {
+			pthread_mutex_unlock(&(channel)->lock);
+			return CLOSED_ERROR;
+		}
+		if (locked_remove(channel, data)) {
+			pthread_mutex_unlock(&(channel)->lock);
+			return SUCCESS;
+		}
+		return handoff_park(channel, &channel->receivers, SEND, data);
+	}
 	//start while loop
 	//while buffer_error, continually check close status
 	//no channel_empty, cond_wait
@@ -93,6 +839,7 @@ enum channel_status channel_receive(channel_t* channel, void** data) {
         }
         //wake thread and unlock
         pthread_cond_signal(&channel->open);
+        wake_selects(channel, SEND);
         pthread_mutex_unlock(&(channel)->lock);
         return SUCCESS;
 }
@@ -113,6 +860,15 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data) {
 	if (!channel) {
 		return GENERIC_ERROR;
 	}
+	if (channel->mode == CHANNEL_SPSC) {
+		return spsc_try_send(channel, data);
+	}
+	if (channel->mode == CHANNEL_MPMC) {
+		return mpmc_try_send(channel, data);
+	}
+	if (channel->mode == CHANNEL_UNBOUNDED) {
+		return unbounded_try_send(channel, data);
+	}
 	pthread_mutex_lock(&(channel)->lock);
 	//channel closed, unlock CLOSED_ERROR
 	if (channel->closed) {
@@ -120,12 +876,13 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data) {
 		return CLOSED_ERROR;
 	}
 	//buffor error,unlock, CHANNEL_FULL
-	if (buffer_add(channel->buffer, data) == BUFFER_ERROR) {
+	if (!locked_add(channel, data)) {
 		pthread_mutex_unlock(&(channel)->lock);
 		return CHANNEL_FULL;
 	}
 	//wake thread and unlock
 	pthread_cond_signal(&channel->recv);
+	wake_selects(channel, RECV);
 	pthread_mutex_unlock(&(channel)->lock);
 	return SUCCESS;
 }
@@ -146,8 +903,17 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
 	if (!channel || !data) {
 		return GENERIC_ERROR;
 	}
+	if (channel->mode == CHANNEL_SPSC) {
+		return spsc_try_receive(channel, data);
+	}
+	if (channel->mode == CHANNEL_MPMC) {
+		return mpmc_try_receive(channel, data);
+	}
+	if (channel->mode == CHANNEL_UNBOUNDED) {
+		return unbounded_try_receive(channel, data);
+	}
 	pthread_mutex_lock(&(channel)->lock);
-	if (buffer_remove(channel->buffer, data) == BUFFER_ERROR){
+	if (!locked_remove(channel, data)) {
 		//multiple errors from BUFFER_ERROR
 		//if closed CLOSED_ERROR
 		//els CHANNEL_EMPTY
@@ -162,10 +928,256 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
 	}
 	//wake thread and unlock
 	pthread_cond_signal(&channel->open);
+	wake_selects(channel, SEND);
 	pthread_mutex_unlock(&(channel)->lock);
 	return SUCCESS;
 }
 
+//batch helpers
+//each call moves as many items as it can in one go and wakes the other side once
+
+//locked mode, lock must be held
+static size_t locked_add_batch(channel_t* channel, void** items, size_t n) {
+	size_t moved = 0;
+	while (moved < n && locked_add(channel, items[moved])) {
+		moved++;
+	}
+	if (moved == 1) {
+		pthread_cond_signal(&channel->recv);
+	} else if (moved > 1) {
+		pthread_cond_broadcast(&channel->recv);
+	}
+	if (moved > 0) {
+		wake_selects(channel, RECV);
+	}
+	return moved;
+}
+
+static size_t locked_remove_batch(channel_t* channel, void** out, size_t max) {
+	size_t moved = 0;
+	while (moved < max && locked_remove(channel, &out[moved])) {
+		moved++;
+	}
+	if (moved == 1) {
+		pthread_cond_signal(&channel->open);
+	} else if (moved > 1) {
+		pthread_cond_broadcast(&channel->open);
+	}
+	if (moved > 0) {
+		wake_selects(channel, SEND);
+	}
+	return moved;
+}
+
+//SPSC mode, one index store for the whole batch
+static enum channel_status spsc_try_send_batch(channel_t* channel, void** items, size_t n,
+		size_t* moved) {
+	*moved = 0;
+	if (spsc_closed(channel)) {
+		return CLOSED_ERROR;
+	}
+	spsc_ring_t* ring = channel->ring;
+	size_t space = spsc_space(ring, n);
+	size_t count = (n < space) ? n : space;
+	if (count == 0) {
+		return CHANNEL_FULL;
+	}
+	for (size_t i = 0; i < count; i++) {
+		channel->buffer->data[(ring->tail + i) & ring->mask] = items[i];
+	}
+	__atomic_store_n(&ring->tail, ring->tail + count, __ATOMIC_SEQ_CST);
+	wait_wake(&channel->recv_waiting, &channel->recv_seq);
+	*moved = count;
+	return SUCCESS;
+}
+
+static enum channel_status spsc_try_receive_batch(channel_t* channel, void** out, size_t max,
+		size_t* moved) {
+	*moved = 0;
+	spsc_ring_t* ring = channel->ring;
+	size_t ready = spsc_ready(ring, max);
+	size_t count = (max < ready) ? max : ready;
+	if (count == 0) {
+		return spsc_closed(channel) ? CLOSED_ERROR : CHANNEL_EMPTY;
+	}
+	for (size_t i = 0; i < count; i++) {
+		out[i] = channel->buffer->data[(ring->head + i) & ring->mask];
+	}
+	__atomic_store_n(&ring->head, ring->head + count, __ATOMIC_SEQ_CST);
+	wait_wake(&channel->send_waiting, &channel->send_seq);
+	*moved = count;
+	return SUCCESS;
+}
+
+//move what fits now in any mode
+//MPMC and UNBOUNDED claim their slots one by one, so they also wake per item
+static enum channel_status try_send_batch(channel_t* channel, void** items, size_t n,
+		size_t* moved) {
+	*moved = 0;
+	if (channel->mode == CHANNEL_SPSC) {
+		return spsc_try_send_batch(channel, items, n, moved);
+	}
+	if (channel->mode == CHANNEL_MPMC || channel->mode == CHANNEL_UNBOUNDED) {
+		enum channel_status (*try_send)(channel_t*, void*) =
+			(channel->mode == CHANNEL_MPMC) ? mpmc_try_send : unbounded_try_send;
+		enum channel_status status = SUCCESS;
+		while (*moved < n && (status = try_send(channel, items[*moved])) == SUCCESS) {
+			(*moved)++;
+		}
+		return (*moved > 0) ? SUCCESS : status;
+	}
+	pthread_mutex_lock(&channel->lock);
+	if (channel->closed) {
+		pthread_mutex_unlock(&channel->lock);
+		return CLOSED_ERROR;
+	}
+	*moved = locked_add_batch(channel, items, n);
+	pthread_mutex_unlock(&channel->lock);
+	return (*moved > 0) ? SUCCESS : CHANNEL_FULL;
+}
+
+static enum channel_status try_receive_batch(channel_t* channel, void** out, size_t max,
+		size_t* moved) {
+	*moved = 0;
+	if (channel->mode == CHANNEL_SPSC) {
+		return spsc_try_receive_batch(channel, out, max, moved);
+	}
+	if (channel->mode == CHANNEL_MPMC || channel->mode == CHANNEL_UNBOUNDED) {
+		enum channel_status (*try_receive)(channel_t*, void**) =
+			(channel->mode == CHANNEL_MPMC) ? mpmc_try_receive : unbounded_try_receive;
+		enum channel_status status = SUCCESS;
+		while (*moved < max && (status = try_receive(channel, &out[*moved])) == SUCCESS) {
+			(*moved)++;
+		}
+		return (*moved > 0) ? SUCCESS : status;
+	}
+	pthread_mutex_lock(&channel->lock);
+	*moved = locked_remove_batch(channel, out, max);
+	enum channel_status status = SUCCESS;
+	if (*moved == 0) {
+		status = channel->closed ? CLOSED_ERROR : CHANNEL_EMPTY;
+	}
+	pthread_mutex_unlock(&channel->lock);
+	return status;
+}
+
+//park until the channel may have space or data again
+static void park_send(channel_t* channel) {
+	if (channel->mode == CHANNEL_SPSC) {
+		wait_park(channel, &channel->send_waiting, &channel->send_seq, spsc_has_space);
+	} else if (channel->mode == CHANNEL_MPMC) {
+		wait_park(channel, &channel->send_waiting, &channel->send_seq, mpmc_has_space);
+	} else if (channel->mode == CHANNEL_UNBOUNDED) {
+		wait_park(channel, &channel->send_waiting, &channel->send_seq, unbounded_has_space);
+	} else {
+		pthread_mutex_lock(&channel->lock);
+		while (buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer)
+			&& !channel->closed) {
+			pthread_cond_wait(&channel->open, &channel->lock);
+		}
+		pthread_mutex_unlock(&channel->lock);
+	}
+}
+
+static void park_receive(channel_t* channel) {
+	if (channel->mode == CHANNEL_SPSC) {
+		wait_park(channel, &channel->recv_waiting, &channel->recv_seq, spsc_has_data);
+	} else if (channel->mode == CHANNEL_MPMC) {
+		wait_park(channel, &channel->recv_waiting, &channel->recv_seq, mpmc_has_data);
+	} else if (channel->mode == CHANNEL_UNBOUNDED) {
+		wait_park(channel, &channel->recv_waiting, &channel->recv_seq, unbounded_has_data);
+	} else {
+		pthread_mutex_lock(&channel->lock);
+		while (buffer_current_size(channel->buffer) == 0 && !channel->closed) {
+			pthread_cond_wait(&channel->recv, &channel->lock);
+		}
+		pthread_mutex_unlock(&channel->lock);
+	}
+}
+
+// Writes the n items in items to the given channel, in order
+// This is a blocking call i.e., the function only returns once all n items are written
+// Each lock acquisition writes as many items as fit and wakes receivers once
+// The number of items written is stored in sent, also when an error is returned
+// An empty batch (n of 0) is rejected, like in the other batch calls
+// Returns SUCCESS for successfully writing all items,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR for an empty batch, a failed allocation or any other generic error
+enum channel_status channel_send_batch(channel_t* channel, void** items, size_t n, size_t* sent) {
+	if (!channel || !items || !sent || n == 0) {
+		return GENERIC_ERROR;
+	}
+	*sent = 0;
+	if (unbuffered(channel)) {
+		//every item is its own handoff
+		for (; *sent < n; (*sent)++) {
+			enum channel_status status = channel_send(channel, items[*sent]);
+			if (status != SUCCESS) {
+				return status;
+			}
+		}
+		return SUCCESS;
+	}
+	while (*sent < n) {
+		size_t moved;
+		enum channel_status status = try_send_batch(channel, items + *sent, n - *sent, &moved);
+		*sent += moved;
+		if (status == CHANNEL_FULL) {
+			park_send(channel);
+		} else if (status != SUCCESS) {
+			return status;
+		}
+	}
+	return SUCCESS;
+}
+
+// Reads up to max items from the given channel into out, in order, and stores the number read in got
+// This is a blocking call i.e., the function waits till the channel has at least one item to read
+// Returns SUCCESS for successful retrieval of at least one item,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch(channel_t* channel, void** out, size_t max, size_t* got) {
+	if (!channel || !out || !got || max == 0) {
+		return GENERIC_ERROR;
+	}
+	if (unbuffered(channel)) {
+		enum channel_status status = channel_receive(channel, out);
+		*got = (status == SUCCESS) ? 1 : 0;
+		return status;
+	}
+	enum channel_status status;
+	while ((status = try_receive_batch(channel, out, max, got)) == CHANNEL_EMPTY) {
+		park_receive(channel);
+	}
+	return status;
+}
+
+// Writes as many of the n items in items as fit to the given channel, in order, and stores the number written in sent
+// This is a non-blocking call i.e., the function simply returns if the channel is full
+// Returns SUCCESS if at least one item was written,
+// CHANNEL_FULL if the channel is full and nothing was written,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_send_batch(channel_t* channel, void** items, size_t n, size_t* sent) {
+	if (!channel || !items || !sent || n == 0) {
+		return GENERIC_ERROR;
+	}
+	return try_send_batch(channel, items, n, sent);
+}
+
+// Reads up to max items from the given channel into out, in order, and stores the number read in got
+// This is a non-blocking call i.e., the function simply returns if the channel is empty
+// Returns SUCCESS if at least one item was read,
+// CHANNEL_EMPTY if the channel is empty and nothing was read,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_receive_batch(channel_t* channel, void** out, size_t max, size_t* got) {
+	if (!channel || !out || !got || max == 0) {
+		return GENERIC_ERROR;
+	}
+	return try_receive_batch(channel, out, max, got);
+}
+
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
 // Returns SUCCESS if close is successful,
@@ -187,10 +1199,17 @@ enum channel_status channel_close(channel_t* channel) {
 		return CLOSED_ERROR;
 	}
 	//set closed
-	channel->closed = true;
+	//SPSC, MPMC and UNBOUNDED senders and receivers read it without the lock
+	__atomic_store_n(&channel->closed, true, __ATOMIC_RELEASE);
 	//wake all looping threads
 	pthread_cond_broadcast(&channel->open);
 	pthread_cond_broadcast(&channel->recv);
+	futex_wake(&channel->send_seq, INT_MAX);
+	futex_wake(&channel->recv_seq, INT_MAX);
+	wake_selects(channel, SEND);
+	wake_selects(channel, RECV);
+	handoff_close(&channel->senders);
+	handoff_close(&channel->receivers);
 	pthread_mutex_unlock(&(channel)->lock);
 	return SUCCESS;
 }
@@ -218,6 +1237,10 @@ enum channel_status channel_destroy(channel_t* channel) {
 	//free all mallocced memory
 	//pthread_destroy functions
 	buffer_free(channel->buffer);
+	free(channel->slots);
+	free(channel->ring);
+	unbounded_free(channel->queue);
+	list_destroy(channel->waiters);
 	pthread_mutex_destroy(&channel->lock);
 	pthread_cond_destroy(&channel->open);
 	pthread_cond_destroy(&channel->recv);
@@ -232,9 +1255,92 @@ enum channel_status channel_destroy(channel_t* channel) {
 // Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
 // In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
 // Additionally, selected_index is set to the index of the channel that generated the error
+// Only CHANNEL_LOCKED channels can be selected on, others return GENERIC_ERROR, and so does an empty channel_list
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
 {
-    /* ONLY FOR BONUS */
-    /* IMPLEMENT THIS */
-    return SUCCESS;
+	//try every channel in order, like the non-blocking calls
+	//a channel that is not ready gets a waiter registered in the same lock hold,
+	//so no send, receive or close after the check can be missed
+	//then sleep on a private semaphore that any of them posts, and try again
+	//registrations stay until select returns, so each pass is O(n) and nothing polls
+	//with nothing to select on the call would sleep forever
+	if (!channel_list || !selected_index || channel_count == 0) {
+		return GENERIC_ERROR;
+	}
+	select_waiter_t* waiters = malloc(channel_count * sizeof(select_waiter_t));
+	bool* registered = calloc(channel_count, sizeof(bool));
+	if (!waiters || !registered) {
+		free(waiters);
+		free(registered);
+		return GENERIC_ERROR;
+	}
+	sem_t wake;
+	sem_init(&wake, 0, 0);
+
+	enum channel_status status = GENERIC_ERROR;
+	size_t index = 0;
+	bool done = false;
+	while (!done) {
+		for (index = 0; index < channel_count; index++) {
+			select_t* op = &channel_list[index];
+			channel_t* channel = op->channel;
+			if (!channel || channel->mode != CHANNEL_LOCKED) {
+				status = GENERIC_ERROR;
+				done = true;
+				break;
+			}
+			pthread_mutex_lock(&channel->lock);
+			if (op->dir == SEND) {
+				if (channel->closed) {
+					status = CLOSED_ERROR;
+				} else if (locked_add(channel, op->data)) {
+					pthread_cond_signal(&channel->recv);
+					wake_selects(channel, RECV);
+					status = SUCCESS;
+				} else {
+					status = CHANNEL_FULL;
+				}
+			} else {
+				if (locked_remove(channel, &op->data)) {
+					pthread_cond_signal(&channel->open);
+					wake_selects(channel, SEND);
+					status = SUCCESS;
+				} else if (channel->closed) {
+					status = CLOSED_ERROR;
+				} else {
+					status = CHANNEL_EMPTY;
+				}
+			}
+			if (status == CHANNEL_FULL && !registered[index]) {
+				//CHANNEL_EMPTY is the same value
+				waiters[index].wake = &wake;
+				waiters[index].dir = op->dir;
+				list_insert(channel->waiters, &waiters[index]);
+				registered[index] = true;
+			}
+			pthread_mutex_unlock(&channel->lock);
+			if (status != CHANNEL_FULL) {
+				done = true;
+				break;
+			}
+		}
+		if (!done) {
+			sem_wait(&wake);
+		}
+	}
+
+	//cancel the other registrations
+	for (size_t i = 0; i < channel_count; i++) {
+		if (registered[i]) {
+			channel_t* channel = channel_list[i].channel;
+			pthread_mutex_lock(&channel->lock);
+			list_remove(channel->waiters, list_find(channel->waiters, &waiters[i]));
+			pthread_mutex_unlock(&channel->lock);
+		}
+	}
+	sem_destroy(&wake);
+	free(waiters);
+	free(registered);
+	*selected_index = index;
+	return status;
 }
@@ -7,6 +7,7 @@
 #include <semaphore.h>
 #include "buffer.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
 #include "linked_list.h"
@@ -22,6 +23,73 @@ enum channel_status {
     DESTROY_ERROR = -3  // Error during destroy
 };
 
+// Defines channel implementations, chosen with channel_create_mode
+enum channel_mode {
+    CHANNEL_LOCKED, // Mutex and condition variables, any number of threads
+    CHANNEL_SPSC,   // Lock-free ring for one sending and one receiving thread
+    CHANNEL_MPMC,   // Lock-free bounded queue for any number of threads
+    CHANNEL_UNBOUNDED // Lock-free queue of linked segments for any number of threads, grows as needed
+};
+
+// Defines one slot of a CHANNEL_MPMC queue
+typedef struct {
+    size_t seq; // 2 * position while free for that position, 2 * position + 1 once filled
+    void* data;
+} mpmc_slot_t;
+
+// Defines the index block of a CHANNEL_SPSC ring
+// The sender's and receiver's halves sit on their own cache lines, each with a cached copy of
+// the other side's index, so a side only reads the other's line when its copy says full or empty
+#define CACHE_LINE 64
+typedef struct {
+    _Alignas(CACHE_LINE) size_t tail; // next position to send, written by the sender
+    size_t head_cache;                // sender's last read of head
+    _Alignas(CACHE_LINE) size_t head; // next position to receive, written by the receiver
+    size_t tail_cache;                // receiver's last read of tail
+    _Alignas(CACHE_LINE) size_t mask; // buffer capacity - 1, the capacity is a power of two
+    size_t capacity;                  // requested capacity, at most mask + 1 messages are held
+} spsc_ring_t;
+
+// Defines one segment of a CHANNEL_UNBOUNDED queue
+// A queue position p is slot p % SEGMENT_LAP of its segment, the extra position in each lap marks
+// the move to the next segment
+#define SEGMENT_SLOTS 31
+#define SEGMENT_LAP (SEGMENT_SLOTS + 1)
+#define SEGMENT_FREELIST 4
+typedef struct segment {
+    struct segment* next; // set by the sender of the last slot
+    struct {
+        void* data;
+        int state;        // SLOT_WRITTEN, SLOT_READ and SLOT_RECYCLE bits
+    } slots[SEGMENT_SLOTS];
+} segment_t;
+
+// Defines the ends of a CHANNEL_UNBOUNDED queue
+// Spent segments are kept in freelist for reuse instead of being freed
+typedef struct {
+    _Alignas(CACHE_LINE) size_t tail; // next position to send
+    segment_t* tail_segment;          // segment of tail
+    _Alignas(CACHE_LINE) size_t head; // next position to receive
+    segment_t* head_segment;          // segment of head
+    _Alignas(CACHE_LINE) segment_t* freelist[SEGMENT_FREELIST];
+    size_t limit;                     // soft limit on queued messages, 0 for none
+} unbounded_queue_t;
+
+// Defines a sender or receiver parked on an unbuffered (size 0) channel
+// The record lives on the parked thread's stack, the peer fills in data and sets done
+typedef struct handoff {
+    void* data;
+    bool done;
+    sem_t wake;
+    struct handoff* next;
+} handoff_t;
+
+// Defines a FIFO of parked handoff records
+typedef struct {
+    handoff_t* head;
+    handoff_t* tail;
+} handoff_queue_t;
+
 // Defines channel object
 typedef struct {
     // DO NOT REMOVE buffer (OR CHANGE ITS NAME) FROM THE STRUCT
@@ -31,6 +99,25 @@ typedef struct {
 	pthread_cond_t open; //slot is open
 	pthread_cond_t recv; //available to recieve
 	bool closed; // treu when closed
+	enum channel_mode mode;
+	bool adaptive; //spin and yield before parking
+	uint32_t spin_limit; //self-tuned spin rounds, 0 on a single CPU
+	mpmc_slot_t* slots; //MPMC queue, NULL in other modes
+	spsc_ring_t* ring; //SPSC indexes, NULL in other modes
+	unbounded_queue_t* queue; //UNBOUNDED segments, NULL in other modes
+	list_t* waiters; //channel_select calls blocked on this channel
+	//unbuffered channels only, threads parked for a direct handoff
+	handoff_queue_t senders;
+	handoff_queue_t receivers;
+	//MPMC positions, they only grow and position i is slot i % capacity
+	//senders CAS tail and receivers CAS head, so each has a line to itself
+	_Alignas(CACHE_LINE) size_t tail; //next position to send
+	_Alignas(CACHE_LINE) size_t head; //next position to receive
+	//read by every send and receive, written only to park and wake
+	_Alignas(CACHE_LINE) int send_waiting; //senders parked on send_seq, and whether the next receive must wake one
+	int recv_waiting; //receivers parked on recv_seq, and whether the next send must wake one
+	uint32_t send_seq; //futex word, bumped to wake parked senders
+	uint32_t recv_seq; //futex word, bumped to wake parked receivers
 
     /* ADD ANY STRUCT ENTRIES YOU NEED HERE */
     /* IMPLEMENT THIS */
@@ -52,8 +139,23 @@ typedef struct {
 } select_t;
 
 // Creates a new channel with the provided size and returns it to the caller
+// A channel of size 0 is unbuffered: each send waits for a receiver and hands its data over directly
 channel_t* channel_create(size_t size);
 
+// Creates a new channel like channel_create, using the given implementation
+// A CHANNEL_SPSC channel must have one thread sending and one thread receiving at a time
+// Its buffer is rounded up to a power of two, but it still holds at most size messages
+// A CHANNEL_UNBOUNDED channel has no fixed capacity, size is a soft limit on the messages it queues
+// Sends block, or return CHANNEL_FULL, while it holds size or more messages, and a size of 0 means no limit
+// Concurrent senders can overshoot the limit by one message each
+// Only CHANNEL_LOCKED channels can be used with channel_select
+// Returns NULL for a CHANNEL_SPSC or CHANNEL_MPMC channel of size 0
+channel_t* channel_create_mode(size_t size, enum channel_mode mode);
+
+// Turns the spin-then-yield phase before parking on or off for a CHANNEL_SPSC, CHANNEL_MPMC or CHANNEL_UNBOUNDED channel
+// It is on by default, a blocked thread then only sleeps once the wait outlasts the tuned spin
+void channel_set_adaptive_wait(channel_t* channel, bool enable);
+
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
@@ -86,6 +188,39 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 // GENERIC_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_receive(channel_t* channel, void** data);
 
+// Writes the n items in items to the given channel, in order
+// This is a blocking call i.e., the function only returns once all n items are written
+// Each lock acquisition writes as many items as fit and wakes receivers once
+// The number of items written is stored in sent, also when an error is returned
+// An empty batch (n of 0) is rejected, like in the other batch calls
+// Returns SUCCESS for successfully writing all items,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR for an empty batch, a failed allocation or any other generic error
+enum channel_status channel_send_batch(channel_t* channel, void** items, size_t n, size_t* sent);
+
+// Reads up to max items from the given channel into out, in order, and stores the number read in got
+// This is a blocking call i.e., the function waits till the channel has at least one item to read
+// Returns SUCCESS for successful retrieval of at least one item,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch(channel_t* channel, void** out, size_t max, size_t* got);
+
+// Writes as many of the n items in items as fit to the given channel, in order, and stores the number written in sent
+// This is a non-blocking call i.e., the function simply returns if the channel is full
+// Returns SUCCESS if at least one item was written,
+// CHANNEL_FULL if the channel is full and nothing was written,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_send_batch(channel_t* channel, void** items, size_t n, size_t* sent);
+
+// Reads up to max items from the given channel into out, in order, and stores the number read in got
+// This is a non-blocking call i.e., the function simply returns if the channel is empty
+// Returns SUCCESS if at least one item was read,
+// CHANNEL_EMPTY if the channel is empty and nothing was read,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_non_blocking_receive_batch(channel_t* channel, void** out, size_t max, size_t* got);
+
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
 // Returns SUCCESS if close is successful,
@@ -107,6 +242,7 @@ enum channel_status channel_destroy(channel_t* channel);
 // Once an operation has been successfully performed, select should set selected_index to the index of the channel that performed the operation and then return SUCCESS
 // In the event that a channel is closed or encounters any error, the error should be propagated and returned through select
 // Additionally, selected_index is set to the index of the channel that generated the error
+// Only CHANNEL_LOCKED channels can be selected on, others return GENERIC_ERROR, and so does an empty channel_list
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index);
 
 #endif // CHANNEL_H
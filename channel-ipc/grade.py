@@ -56,6 +56,25 @@ add_test_case_channel("test_overall_send_receive", iters_one)
 add_test_case_sanitize("test_overall_send_receive", iters_one)
 add_test_case_valgrind("test_overall_send_receive", iters_one, timeout_valgrind * 5)
 add_test_cases("test_stress_send_recv", iters_one, timeout_stress_send_recv)
+add_test_case_channel("test_stress_send_recv_spsc", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_stress_send_recv_spsc", iters_one, timeout_stress_send_recv)
+add_test_case_channel("test_stress_send_recv_mpmc", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_stress_send_recv_mpmc", iters_one, timeout_stress_send_recv * 3)
+add_test_case_channel("test_stress_send_recv_unbounded", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_stress_send_recv_unbounded", iters_one, timeout_stress_send_recv * 3)
+add_test_case_channel("test_stress_send_recv_batch", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_stress_send_recv_batch", iters_one, timeout_stress_send_recv)
+add_test_case_channel("test_rendezvous", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_rendezvous", iters_one, timeout_stress_send_recv)
+add_test_cases("test_rendezvous_close", iters_slow)
+add_test_case_channel("test_handoff_latency", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_handoff_latency", iters_one, timeout_stress_send_recv)
+add_test_case_channel("test_shared_channel", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_shared_channel", iters_one, timeout_stress_send_recv)
+add_test_case_channel("test_shared_channel_stale", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_shared_channel_stale", iters_one, timeout_stress_send_recv)
+add_test_case_channel("test_byte_channel", iters_one, timeout_stress_send_recv)
+add_test_case_sanitize("test_byte_channel", iters_one, timeout_stress_send_recv)
 add_test_cases("test_response_time", iters_one, timeout_response_time)
 add_test_cases("test_cpu_utilization_send", iters_one, timeout_cpu_utilization)
 add_test_cases("test_cpu_utilization_receive", iters_one, timeout_cpu_utilization)
@@ -67,6 +86,7 @@ add_test_case_sanitize("test_channel_close_with_receive", iters_slow)
 add_test_case_valgrind("test_channel_close_with_receive", iters_slow, timeout_valgrind * 2)
 add_test_cases("test_select", iters_slow)
 add_test_cases("test_select_close", iters_slow)
+add_test_cases("test_select_empty")
 add_test_cases("test_select_and_non_blocking_send_size1", iters_slow)
 add_test_cases("test_select_and_non_blocking_receive_size1", iters_slow)
 add_test_cases("test_select_with_select_size1", iters_slow)
@@ -77,6 +97,8 @@ add_test_case_channel("test_stress", iters_one, timeout_channel * 5)
 add_test_case_sanitize("test_stress", iters_one, timeout_sanitize * 5)
 add_test_case_valgrind("test_stress", iters_one, timeout_valgrind * 5)
 add_test_cases("test_select_response_time", iters_one, timeout_response_time)
+add_test_case_channel("test_select_benchmark", iters_one)
+add_test_case_sanitize("test_select_benchmark", iters_one, timeout_sanitize * 3)
 add_test_cases("test_cpu_utilization_select", iters_one, timeout_cpu_utilization)
 add_test_cases("test_cpu_utilization_overall", iters_one, timeout_cpu_utilization)
 add_test_cases("test_for_too_many_wakeups", iters_one, timeout_too_many_wakeups)
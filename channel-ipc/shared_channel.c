@@ -0,0 +1,299 @@
+#include "shared_channel.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//a shared channel is one shm_open segment: a header with process-shared
+//mutex and conds, then capacity slots of msg_size bytes used as a ring
+//the creator wins the O_EXCL open, sizes the segment, initializes the header
+//and only then publishes ready; other openers wait for the size, then ready
+//the mutex is robust, so a process dying while holding it does not wedge the
+//others; the ring indexes only change after a message is copied, so they are
+//consistent whenever the lock is dropped
+//a creator that dies before publishing ready would leave openers waiting
+//forever, so they give up after OPEN_WAIT_NS; they leave the name alone, by
+//then it may belong to a new channel, and cleanup is channel_unlink_shared's
+
+#define OPEN_WAIT_NS 1000000000ull
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t segment_size(size_t capacity, size_t msg_size) {
+	return sizeof(shared_segment_t) + capacity * msg_size;
+}
+
+static void segment_init(shared_segment_t* segment, size_t capacity, size_t msg_size) {
+	pthread_mutexattr_t mutex_attr;
+	pthread_mutexattr_init(&mutex_attr);
+	pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&segment->lock, &mutex_attr);
+	pthread_mutexattr_destroy(&mutex_attr);
+
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+	pthread_cond_init(&segment->open, &cond_attr);
+	pthread_cond_init(&segment->recv, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
+	segment->closed = false;
+	segment->capacity = capacity;
+	segment->msg_size = msg_size;
+	segment->head = 0;
+	segment->size = 0;
+	__atomic_store_n(&segment->ready, SHARED_CHANNEL_MAGIC, __ATOMIC_RELEASE);
+}
+
+static void shared_lock(shared_segment_t* segment) {
+	if (pthread_mutex_lock(&segment->lock) == EOWNERDEAD) {
+		pthread_mutex_consistent(&segment->lock);
+	}
+}
+
+static void shared_wait(shared_segment_t* segment, pthread_cond_t* cond) {
+	if (pthread_cond_wait(cond, &segment->lock) == EOWNERDEAD) {
+		pthread_mutex_consistent(&segment->lock);
+	}
+}
+
+//copy msg into the next free slot, lock must be held
+static enum channel_status shared_add(shared_segment_t* segment, const void* msg) {
+	if (segment->closed) {
+		return CLOSED_ERROR;
+	}
+	if (segment->size == segment->capacity) {
+		return CHANNEL_FULL;
+	}
+	size_t slot = segment->head + segment->size;
+	if (slot >= segment->capacity) {
+		slot -= segment->capacity;
+	}
+	memcpy(segment->slots + slot * segment->msg_size, msg, segment->msg_size);
+	segment->size++;
+	pthread_cond_signal(&segment->recv);
+	return SUCCESS;
+}
+
+//copy the oldest message out into msg, lock must be held
+static enum channel_status shared_remove(shared_segment_t* segment, void* msg) {
+	if (segment->size == 0) {
+		//drained, same as the locked channel
+		return segment->closed ? CLOSED_ERROR : CHANNEL_EMPTY;
+	}
+	memcpy(msg, segment->slots + segment->head * segment->msg_size, segment->msg_size);
+	segment->head++;
+	if (segment->head >= segment->capacity) {
+		segment->head -= segment->capacity;
+	}
+	segment->size--;
+	pthread_cond_signal(&segment->open);
+	return SUCCESS;
+}
+
+// Opens the shared channel called name (a shm_open name such as "/jobs"), creating it if it does not exist
+// Every process that opens the same name exchanges messages of msg_size bytes through capacity slots
+// Returns NULL if capacity or msg_size is 0, if an existing channel was created with a different
+// capacity or msg_size, or if the shared memory cannot be created or mapped
+// Also returns NULL if the creator has not initialized the channel within a second, the name is
+// left as it is, channel_unlink_shared removes a stale one so a later call creates a new channel
+shared_channel_t* channel_open_shared(const char* name, size_t capacity, size_t msg_size) {
+	if (!name || capacity == 0 || msg_size == 0
+		|| msg_size > (SIZE_MAX - sizeof(shared_segment_t)) / capacity) {
+		return NULL;
+	}
+	size_t size = segment_size(capacity, msg_size);
+	bool created = true;
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		created = false;
+		fd = shm_open(name, O_RDWR, 0600);
+	}
+	if (fd < 0) {
+		return NULL;
+	}
+	uint64_t deadline = now_ns() + OPEN_WAIT_NS;
+	if (created) {
+		if (ftruncate(fd, (off_t)size) != 0) {
+			close(fd);
+			shm_unlink(name);
+			return NULL;
+		}
+	} else {
+		//the creator may not have sized it yet
+		struct stat st;
+		while (true) {
+			if (fstat(fd, &st) != 0) {
+				close(fd);
+				return NULL;
+			}
+			if (st.st_size != 0) {
+				break;
+			}
+			if (now_ns() > deadline) {
+				close(fd);
+				return NULL;
+			}
+			sched_yield();
+		}
+		if ((size_t)st.st_size != size) {
+			close(fd);
+			return NULL;
+		}
+	}
+	shared_segment_t* segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (segment == MAP_FAILED) {
+		if (created) {
+			shm_unlink(name);
+		}
+		return NULL;
+	}
+	if (created) {
+		segment_init(segment, capacity, msg_size);
+	} else {
+		while (__atomic_load_n(&segment->ready, __ATOMIC_ACQUIRE) != SHARED_CHANNEL_MAGIC) {
+			if (now_ns() > deadline) {
+				munmap(segment, size);
+				return NULL;
+			}
+			sched_yield();
+		}
+		if (segment->capacity != capacity || segment->msg_size != msg_size) {
+			munmap(segment, size);
+			return NULL;
+		}
+	}
+	shared_channel_t* channel = malloc(sizeof(shared_channel_t));
+	if (!channel) {
+		munmap(segment, size);
+		return NULL;
+	}
+	channel->segment = segment;
+	channel->map_size = size;
+	return channel;
+}
+
+// Copies msg_size bytes from msg into the shared channel
+// This is a blocking call i.e., the function waits till the channel has a free slot
+// Returns SUCCESS for successfully writing the message,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_send(shared_channel_t* channel, const void* msg) {
+	if (!channel || !msg) {
+		return GENERIC_ERROR;
+	}
+	shared_segment_t* segment = channel->segment;
+	shared_lock(segment);
+	enum channel_status status;
+	while ((status = shared_add(segment, msg)) == CHANNEL_FULL) {
+		shared_wait(segment, &segment->open);
+	}
+	pthread_mutex_unlock(&segment->lock);
+	return status;
+}
+
+// Copies the next message of the shared channel into msg, which must hold msg_size bytes
+// This is a blocking call i.e., the function waits till the channel has a message to read
+// Returns SUCCESS for successful retrieval of a message,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_receive(shared_channel_t* channel, void* msg) {
+	if (!channel || !msg) {
+		return GENERIC_ERROR;
+	}
+	shared_segment_t* segment = channel->segment;
+	shared_lock(segment);
+	enum channel_status status;
+	while ((status = shared_remove(segment, msg)) == CHANNEL_EMPTY) {
+		shared_wait(segment, &segment->recv);
+	}
+	pthread_mutex_unlock(&segment->lock);
+	return status;
+}
+
+// Copies msg_size bytes from msg into the shared channel
+// This is a non-blocking call i.e., the function simply returns if the channel is full
+// Returns SUCCESS for successfully writing the message,
+// CHANNEL_FULL if the channel is full and nothing was written,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_non_blocking_send(shared_channel_t* channel, const void* msg) {
+	if (!channel || !msg) {
+		return GENERIC_ERROR;
+	}
+	shared_lock(channel->segment);
+	enum channel_status status = shared_add(channel->segment, msg);
+	pthread_mutex_unlock(&channel->segment->lock);
+	return status;
+}
+
+// Copies the next message of the shared channel into msg, which must hold msg_size bytes
+// This is a non-blocking call i.e., the function simply returns if the channel is empty
+// Returns SUCCESS for successful retrieval of a message,
+// CHANNEL_EMPTY if the channel is empty and nothing was read,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_non_blocking_receive(shared_channel_t* channel, void* msg) {
+	if (!channel || !msg) {
+		return GENERIC_ERROR;
+	}
+	shared_lock(channel->segment);
+	enum channel_status status = shared_remove(channel->segment, msg);
+	pthread_mutex_unlock(&channel->segment->lock);
+	return status;
+}
+
+// Closes the shared channel for every process and wakes all their blocked calls
+// Receivers still drain the messages left in the channel before seeing CLOSED_ERROR
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_shared_close(shared_channel_t* channel) {
+	if (!channel) {
+		return GENERIC_ERROR;
+	}
+	shared_segment_t* segment = channel->segment;
+	shared_lock(segment);
+	if (segment->closed) {
+		pthread_mutex_unlock(&segment->lock);
+		return CLOSED_ERROR;
+	}
+	segment->closed = true;
+	pthread_cond_broadcast(&segment->open);
+	pthread_cond_broadcast(&segment->recv);
+	pthread_mutex_unlock(&segment->lock);
+	return SUCCESS;
+}
+
+// Unmaps the shared channel from this process and frees the handle
+// The channel itself lives on until it is unlinked and every process has detached
+// Returns SUCCESS if detach is successful, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_shared_detach(shared_channel_t* channel) {
+	if (!channel) {
+		return GENERIC_ERROR;
+	}
+	int result = munmap(channel->segment, channel->map_size);
+	free(channel);
+	return (result == 0) ? SUCCESS : GENERIC_ERROR;
+}
+
+// Removes the name of a shared channel, later channel_open_shared calls create a new one
+// Returns SUCCESS if unlink is successful, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_unlink_shared(const char* name) {
+	if (!name || shm_unlink(name) != 0) {
+		return GENERIC_ERROR;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,93 @@
+#ifndef SHARED_CHANNEL_H
+#define SHARED_CHANNEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "channel.h"
+
+// Marks a shared segment whose header is fully initialized
+#define SHARED_CHANNEL_MAGIC 0x43484e4cu
+
+// Defines the memory shared by every process that opened a channel
+// Messages are copied into fixed-size slots inline after the header, so nothing in the
+// segment points outside it and each process can map it at a different address
+typedef struct {
+    uint32_t ready;        // set to SHARED_CHANNEL_MAGIC once the creator has initialized the segment
+    pthread_mutex_t lock;  // process-shared
+    pthread_cond_t open;   // slot is open, process-shared
+    pthread_cond_t recv;   // available to receive, process-shared
+    bool closed;
+    size_t capacity;       // number of slots
+    size_t msg_size;       // bytes per message
+    size_t head;           // next slot to receive
+    size_t size;           // messages in the ring
+    unsigned char slots[]; // capacity * msg_size bytes
+} shared_segment_t;
+
+// Defines one process's handle on a shared channel
+typedef struct {
+    shared_segment_t* segment;
+    size_t map_size;
+} shared_channel_t;
+
+// Opens the shared channel called name (a shm_open name such as "/jobs"), creating it if it does not exist
+// Every process that opens the same name exchanges messages of msg_size bytes through capacity slots
+// Returns NULL if capacity or msg_size is 0, if an existing channel was created with a different
+// capacity or msg_size, or if the shared memory cannot be created or mapped
+// Also returns NULL if the creator has not initialized the channel within a second, the name is
+// left as it is, channel_unlink_shared removes a stale one so a later call creates a new channel
+shared_channel_t* channel_open_shared(const char* name, size_t capacity, size_t msg_size);
+
+// Copies msg_size bytes from msg into the shared channel
+// This is a blocking call i.e., the function waits till the channel has a free slot
+// Returns SUCCESS for successfully writing the message,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_send(shared_channel_t* channel, const void* msg);
+
+// Copies the next message of the shared channel into msg, which must hold msg_size bytes
+// This is a blocking call i.e., the function waits till the channel has a message to read
+// Returns SUCCESS for successful retrieval of a message,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_receive(shared_channel_t* channel, void* msg);
+
+// Copies msg_size bytes from msg into the shared channel
+// This is a non-blocking call i.e., the function simply returns if the channel is full
+// Returns SUCCESS for successfully writing the message,
+// CHANNEL_FULL if the channel is full and nothing was written,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_non_blocking_send(shared_channel_t* channel, const void* msg);
+
+// Copies the next message of the shared channel into msg, which must hold msg_size bytes
+// This is a non-blocking call i.e., the function simply returns if the channel is empty
+// Returns SUCCESS for successful retrieval of a message,
+// CHANNEL_EMPTY if the channel is empty and nothing was read,
+// CLOSED_ERROR if the channel is closed and empty, and
+// GENERIC_ERROR on encountering any other generic error of any sort
+enum channel_status channel_shared_non_blocking_receive(shared_channel_t* channel, void* msg);
+
+// Closes the shared channel for every process and wakes all their blocked calls
+// Receivers still drain the messages left in the channel before seeing CLOSED_ERROR
+// Returns SUCCESS if close is successful,
+// CLOSED_ERROR if the channel is already closed, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_shared_close(shared_channel_t* channel);
+
+// Unmaps the shared channel from this process and frees the handle
+// The channel itself lives on until it is unlinked and every process has detached
+// Returns SUCCESS if detach is successful, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_shared_detach(shared_channel_t* channel);
+
+// Removes the name of a shared channel, later channel_open_shared calls create a new one
+// Returns SUCCESS if unlink is successful, and
+// GENERIC_ERROR in any other error case
+enum channel_status channel_unlink_shared(const char* name);
+
+#endif // SHARED_CHANNEL_H
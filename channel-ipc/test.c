@@ -10,6 +10,12 @@
 #include <stdbool.h>
 #include "stress.h"
 #include "stress_send_recv.h"
+#include "shared_channel.h"
+#include "byte_channel.h"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 #define mu_str_(text) #text
 #define mu_str(text) mu_str_(text)
@@ -976,6 +982,22 @@ char* test_select_close() {
     return NULL;
 }
 
+char* test_select_empty() {
+    print_test_details(__func__, "Testing select with no channels");
+
+    channel_t* channel = channel_create(1);
+    select_t list[1] = {{channel, RECV, NULL}};
+    size_t index = 7;
+
+    mu_assert("test_select_empty: Select on no channels should return GENERIC_ERROR", channel_select(list, 0, &index) == GENERIC_ERROR);
+    mu_assert("test_select_empty: Select on no channels should not set the index", index == 7);
+    mu_assert("test_select_empty: Select on a NULL list should return GENERIC_ERROR", channel_select(NULL, 0, &index) == GENERIC_ERROR);
+
+    mu_assert("test_select_empty: Can't close channel", channel_close(channel) == SUCCESS);
+    channel_destroy(channel);
+    return NULL;
+}
+
 char* test_cpu_utilization_send() {
     print_test_details(__func__, "Testing CPU utilization for send API (takes around 30 seconds)");
 
@@ -1160,6 +1182,1092 @@ char* test_stress_send_recv() {
     return NULL;
 }
 
+typedef struct {
+    channel_t *channel;
+    size_t count;
+    size_t errors;
+    size_t sum;
+} bench_args;
+
+void* bench_sender(bench_args *myargs) {
+    for (size_t i = 1; i <= myargs->count; i++) {
+        if (channel_send(myargs->channel, (void*)i) != SUCCESS) {
+            myargs->errors++;
+        }
+    }
+    return NULL;
+}
+
+void* bench_receiver(bench_args *myargs) {
+    void* data = NULL;
+    for (size_t i = 1; i <= myargs->count; i++) {
+        if (channel_receive(myargs->channel, &data) != SUCCESS || (size_t)data != i) {
+            myargs->errors++;
+        }
+    }
+    return NULL;
+}
+
+/* Sends count messages from one thread to another, returns messages per second.
+ * Messages out of order or failed calls are added to errors.
+ */
+double bench_send_recv_1to1(channel_t* channel, size_t count, size_t* errors) {
+    pthread_t sender, receiver;
+    bench_args send_args = {channel, count, 0, 0};
+    bench_args recv_args = {channel, count, 0, 0};
+
+    uint64_t t = getTime();
+    pthread_create(&receiver, NULL, (void *)bench_receiver, &recv_args);
+    pthread_create(&sender, NULL, (void *)bench_sender, &send_args);
+    pthread_join(sender, NULL);
+    pthread_join(receiver, NULL);
+    t = getTime() - t;
+
+    *errors += send_args.errors + recv_args.errors;
+    return (double)count / convertTimeToSeconds(t);
+}
+
+void* bench_receiver_any(bench_args *myargs) {
+    void* data = NULL;
+    for (size_t i = 1; i <= myargs->count; i++) {
+        if (channel_receive(myargs->channel, &data) != SUCCESS) {
+            myargs->errors++;
+        }
+        myargs->sum += (size_t)data;
+    }
+    return NULL;
+}
+
+/* Sends count messages split over senders threads to receivers threads, returns messages per second.
+ * count must be a multiple of both thread counts. Lost or duplicated messages are added to errors.
+ */
+double bench_send_recv(channel_t* channel, size_t senders, size_t receivers, size_t count, size_t* errors) {
+    pthread_t pid[senders + receivers];
+    bench_args args[senders + receivers];
+    size_t sum = 0;
+
+    uint64_t t = getTime();
+    for (size_t i = 0; i < senders + receivers; i++) {
+        args[i] = (bench_args){channel, i < senders ? count / senders : count / receivers, 0, 0};
+        pthread_create(&pid[i], NULL, i < senders ? (void *)bench_sender : (void *)bench_receiver_any, &args[i]);
+    }
+    for (size_t i = 0; i < senders + receivers; i++) {
+        pthread_join(pid[i], NULL);
+        *errors += args[i].errors;
+        sum += args[i].sum;
+    }
+    t = getTime() - t;
+
+    size_t per_sender = count / senders;
+    if (sum != senders * per_sender * (per_sender + 1) / 2) {
+        (*errors)++;
+    }
+    return (double)count / convertTimeToSeconds(t);
+}
+
+char* test_stress_send_recv_spsc() {
+    print_test_details(__func__, "Benchmarking 1:1 send/recv on locked and SPSC channels");
+    size_t capacities[] = {1, 16, 1000, 1024};
+    size_t count = 200000;
+
+    for (size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++) {
+        size_t errors = 0;
+        channel_t* locked = channel_create_mode(capacities[i], CHANNEL_LOCKED);
+        channel_t* spsc = channel_create_mode(capacities[i], CHANNEL_SPSC);
+        double locked_rate = bench_send_recv_1to1(locked, count, &errors);
+        double spsc_rate = bench_send_recv_1to1(spsc, count, &errors);
+        printf("  capacity %4zu: locked %6.2f Mmsg/s, spsc %6.2f Mmsg/s\n",
+               capacities[i], locked_rate / 1e6, spsc_rate / 1e6);
+        mu_assert("test_stress_send_recv_spsc: Messages lost or out of order", errors == 0);
+
+        // a parked receiver must see close
+        receive_args args;
+        pthread_t pid;
+        init_object_for_receive_api(&args, spsc, NULL);
+        pthread_create(&pid, NULL, (void *)helper_receive, &args);
+        usleep(10000);
+        mu_assert("test_stress_send_recv_spsc: Close failed", channel_close(spsc) == SUCCESS);
+        pthread_join(pid, NULL);
+        mu_assert("test_stress_send_recv_spsc: Receive did not return CLOSED_ERROR", args.out == CLOSED_ERROR);
+        mu_assert("test_stress_send_recv_spsc: Send did not return CLOSED_ERROR", channel_send(spsc, "Message") == CLOSED_ERROR);
+
+        channel_close(locked);
+        channel_destroy(locked);
+        channel_destroy(spsc);
+    }
+    mu_assert("test_stress_send_recv_spsc: SPSC channel of size 0 created", channel_create_mode(0, CHANNEL_SPSC) == NULL);
+
+    // the ring is rounded up to a power of two but must still hold only the requested size
+    channel_t* channel = channel_create_mode(3, CHANNEL_SPSC);
+    void* data = NULL;
+    mu_assert("test_stress_send_recv_spsc: Ring not rounded up", buffer_capacity(channel->buffer) == 4);
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t i = 0; i < 3; i++) {
+            mu_assert("test_stress_send_recv_spsc: Send failed", channel_non_blocking_send(channel, (void*)(i + 1)) == SUCCESS);
+        }
+        mu_assert("test_stress_send_recv_spsc: Send past the requested size succeeded", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+        for (size_t i = 0; i < 3; i++) {
+            mu_assert("test_stress_send_recv_spsc: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+            mu_assert("test_stress_send_recv_spsc: Invalid message", (size_t)data == i + 1);
+        }
+        mu_assert("test_stress_send_recv_spsc: Receive from an empty channel succeeded", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    }
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_stress_send_recv_mpmc() {
+    print_test_details(__func__, "Benchmarking send/recv scaling on locked and MPMC channels");
+    size_t count = 192000;
+    size_t capacity = 64;
+
+    printf("  %8s %9s %12s %12s\n", "senders", "receivers", "locked", "mpmc");
+    for (size_t threads = 1; threads <= 32; threads *= 2) {
+        // n:n, and the 4:16 shape of test_stress_send_recv
+        size_t shapes[2][2] = {{threads, threads}, {4, 16}};
+        for (size_t s = 0; s < (threads == 32 ? 2 : 1); s++) {
+            size_t errors = 0;
+            channel_t* locked = channel_create_mode(capacity, CHANNEL_LOCKED);
+            channel_t* mpmc = channel_create_mode(capacity, CHANNEL_MPMC);
+            double locked_rate = bench_send_recv(locked, shapes[s][0], shapes[s][1], count, &errors);
+            double mpmc_rate = bench_send_recv(mpmc, shapes[s][0], shapes[s][1], count, &errors);
+            printf("  %8zu %9zu %6.2f Mmsg/s %6.2f Mmsg/s\n", shapes[s][0], shapes[s][1],
+                   locked_rate / 1e6, mpmc_rate / 1e6);
+            mu_assert("test_stress_send_recv_mpmc: Messages lost or duplicated", errors == 0);
+            channel_close(locked);
+            channel_destroy(locked);
+            channel_close(mpmc);
+            channel_destroy(mpmc);
+        }
+    }
+
+    // capacity 1 must still hold one message at a time, and close must wake parked receivers
+    channel_t* channel = channel_create_mode(1, CHANNEL_MPMC);
+    void* data = NULL;
+    mu_assert("test_stress_send_recv_mpmc: Send failed", channel_non_blocking_send(channel, "Message1") == SUCCESS);
+    mu_assert("test_stress_send_recv_mpmc: Send to a full channel succeeded", channel_non_blocking_send(channel, "Message2") == CHANNEL_FULL);
+    mu_assert("test_stress_send_recv_mpmc: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+    mu_assert("test_stress_send_recv_mpmc: Invalid message", string_equal(data, "Message1"));
+    mu_assert("test_stress_send_recv_mpmc: Receive from an empty channel succeeded", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    receive_args args[4];
+    pthread_t pid[4];
+    for (size_t i = 0; i < 4; i++) {
+        init_object_for_receive_api(&args[i], channel, NULL);
+        pthread_create(&pid[i], NULL, (void *)helper_receive, &args[i]);
+    }
+    usleep(10000);
+    mu_assert("test_stress_send_recv_mpmc: Close failed", channel_close(channel) == SUCCESS);
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_stress_send_recv_mpmc: Receive did not return CLOSED_ERROR", args[i].out == CLOSED_ERROR);
+    }
+    channel_destroy(channel);
+
+    // a sender that claimed a slot before the close still delivers, here the test stands in for
+    // a sender stalled between its claim and its write
+    channel = channel_create_mode(4, CHANNEL_MPMC);
+    channel->tail = 1;
+    mu_assert("test_stress_send_recv_mpmc: Close failed", channel_close(channel) == SUCCESS);
+    init_object_for_receive_api(&args[0], channel, NULL);
+    pthread_create(&pid[0], NULL, (void *)helper_receive, &args[0]);
+    usleep(10000);
+    channel->slots[0].data = "Message1";
+    __atomic_store_n(&channel->slots[0].seq, 1, __ATOMIC_SEQ_CST);
+    pthread_join(pid[0], NULL);
+    mu_assert("test_stress_send_recv_mpmc: Claimed message was lost on close", args[0].out == SUCCESS);
+    mu_assert("test_stress_send_recv_mpmc: Invalid message", string_equal(args[0].data, "Message1"));
+    mu_assert("test_stress_send_recv_mpmc: Receive after the last message did not return CLOSED_ERROR",
+              channel_receive(channel, &data) == CLOSED_ERROR);
+    channel_destroy(channel);
+    return NULL;
+}
+
+/* Sends a burst of count messages from this thread to a receiver thread.
+ * Returns the time the sender took in seconds and stores the time until the receiver had them all in total.
+ */
+double bench_burst(channel_t* channel, size_t count, double* total, size_t* errors) {
+    pthread_t receiver;
+    bench_args recv_args = {channel, count, 0, 0};
+    bench_args send_args = {channel, count, 0, 0};
+
+    uint64_t t = getTime();
+    pthread_create(&receiver, NULL, (void *)bench_receiver, &recv_args);
+    bench_sender(&send_args);
+    uint64_t sent = getTime() - t;
+    pthread_join(receiver, NULL);
+    *total = convertTimeToSeconds(getTime() - t);
+
+    *errors += send_args.errors + recv_args.errors;
+    return convertTimeToSeconds(sent);
+}
+
+size_t freelist_size(channel_t* channel) {
+    size_t n = 0;
+    for (size_t i = 0; i < SEGMENT_FREELIST; i++) {
+        n += channel->queue->freelist[i] != NULL;
+    }
+    return n;
+}
+
+char* test_stress_send_recv_unbounded() {
+    print_test_details(__func__, "Testing unbounded channels and benchmarking against bounded MPMC channels");
+    size_t count = 192000;
+    void* data = NULL;
+
+    // grows across many segments with nobody receiving, then reuses the spent ones
+    channel_t* channel = channel_create_mode(0, CHANNEL_UNBOUNDED);
+    mu_assert("test_stress_send_recv_unbounded: Could not create channel", channel != NULL);
+    for (size_t round = 0; round < 2; round++) {
+        for (size_t i = 1; i <= 10000; i++) {
+            mu_assert("test_stress_send_recv_unbounded: Send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+        }
+        mu_assert("test_stress_send_recv_unbounded: Spent segments not reused", round == 0 || freelist_size(channel) == 0);
+        for (size_t i = 1; i <= 10000; i++) {
+            mu_assert("test_stress_send_recv_unbounded: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+            mu_assert("test_stress_send_recv_unbounded: Messages out of order", (size_t)data == i);
+        }
+        mu_assert("test_stress_send_recv_unbounded: Receive from an empty channel succeeded", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+        mu_assert("test_stress_send_recv_unbounded: Spent segments not kept", freelist_size(channel) == SEGMENT_FREELIST);
+    }
+
+    // a parked receiver must see close, and the channel drains first
+    receive_args recv;
+    pthread_t pid;
+    init_object_for_receive_api(&recv, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &recv);
+    usleep(10000);
+    mu_assert("test_stress_send_recv_unbounded: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_stress_send_recv_unbounded: Receive did not return CLOSED_ERROR", recv.out == CLOSED_ERROR);
+    mu_assert("test_stress_send_recv_unbounded: Send did not return CLOSED_ERROR", channel_send(channel, "Message") == CLOSED_ERROR);
+    channel_destroy(channel);
+
+    // the soft limit pushes back on senders until a receive makes room
+    channel = channel_create_mode(100, CHANNEL_UNBOUNDED);
+    for (size_t i = 1; i <= 100; i++) {
+        mu_assert("test_stress_send_recv_unbounded: Send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_stress_send_recv_unbounded: Send past the soft limit succeeded", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+    send_args send;
+    init_object_for_send_api(&send, channel, "Message", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &send);
+    usleep(10000);
+    mu_assert("test_stress_send_recv_unbounded: Send past the soft limit did not block", send.out == GENERIC_ERROR);
+    mu_assert("test_stress_send_recv_unbounded: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_stress_send_recv_unbounded: Blocked send did not finish", send.out == SUCCESS);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    // steady throughput
+    printf("  %8s %9s %12s %12s %12s\n", "senders", "receivers", "mpmc 64", "unbounded", "limit 64");
+    size_t shapes[3][2] = {{1, 1}, {4, 4}, {4, 16}};
+    for (size_t s = 0; s < 3; s++) {
+        size_t errors = 0;
+        channel_t* channels[] = {channel_create_mode(64, CHANNEL_MPMC),
+                                 channel_create_mode(0, CHANNEL_UNBOUNDED),
+                                 channel_create_mode(64, CHANNEL_UNBOUNDED)};
+        double rates[3];
+        for (size_t c = 0; c < 3; c++) {
+            rates[c] = bench_send_recv(channels[c], shapes[s][0], shapes[s][1], count, &errors);
+            channel_close(channels[c]);
+            channel_destroy(channels[c]);
+        }
+        printf("  %8zu %9zu %6.2f Mmsg/s %6.2f Mmsg/s %6.2f Mmsg/s\n", shapes[s][0], shapes[s][1],
+               rates[0] / 1e6, rates[1] / 1e6, rates[2] / 1e6);
+        mu_assert("test_stress_send_recv_unbounded: Messages lost or duplicated", errors == 0);
+    }
+
+    // a burst from one sender: a bounded channel holds the sender back to the receiver's pace
+    printf("  %-12s %12s %12s\n", "burst", "sender done", "all received");
+    channel_t* channels[] = {channel_create_mode(64, CHANNEL_MPMC),
+                             channel_create_mode(count, CHANNEL_MPMC),
+                             channel_create_mode(0, CHANNEL_UNBOUNDED)};
+    const char* names[] = {"mpmc 64", "mpmc burst", "unbounded"};
+    for (size_t c = 0; c < 3; c++) {
+        size_t errors = 0;
+        double total;
+        double sent = bench_burst(channels[c], count, &total, &errors);
+        mu_assert("test_stress_send_recv_unbounded: Messages lost or out of order", errors == 0);
+        printf("  %-12s %9.2f ms %9.2f ms\n", names[c], sent * 1e3, total * 1e3);
+        channel_close(channels[c]);
+        channel_destroy(channels[c]);
+    }
+    return NULL;
+}
+
+typedef struct {
+    bench_args bench;
+    size_t batch;
+} batch_args;
+
+void* bench_batch_sender(batch_args *myargs) {
+    bench_args* bench = &myargs->bench;
+    void* items[myargs->batch];
+    for (size_t i = 1; i <= bench->count; i += myargs->batch) {
+        size_t n = 0, sent = 0;
+        for (; n < myargs->batch && i + n <= bench->count; n++) {
+            items[n] = (void*)(i + n);
+        }
+        if (channel_send_batch(bench->channel, items, n, &sent) != SUCCESS || sent != n) {
+            bench->errors++;
+        }
+    }
+    return NULL;
+}
+
+void* bench_batch_receiver(batch_args *myargs) {
+    bench_args* bench = &myargs->bench;
+    void* out[myargs->batch];
+    size_t i = 1;
+    while (i <= bench->count) {
+        size_t got = 0;
+        if (channel_receive_batch(bench->channel, out, myargs->batch, &got) != SUCCESS) {
+            bench->errors++;
+            break;
+        }
+        for (size_t j = 0; j < got; j++, i++) {
+            if ((size_t)out[j] != i) {
+                bench->errors++;
+            }
+        }
+    }
+    return NULL;
+}
+
+char* test_stress_send_recv_batch() {
+    print_test_details(__func__, "Benchmarking per-message cost of batched send/recv");
+    size_t batches[] = {1, 4, 16, 64};
+    size_t count = 200000;
+    size_t capacity = 1024;
+
+    printf("  %6s %14s %14s\n", "batch", "wall per msg", "cpu per msg");
+    for (size_t k = 0; k < sizeof(batches) / sizeof(batches[0]); k++) {
+        channel_t* channel = channel_create(capacity);
+        batch_args send_args = {{channel, count, 0, 0}, batches[k]};
+        batch_args recv_args = {{channel, count, 0, 0}, batches[k]};
+        pthread_t sender, receiver;
+
+        struct rusage usage1, usage2;
+        getrusage(RUSAGE_SELF, &usage1);
+        uint64_t t = getTime();
+        pthread_create(&receiver, NULL, (void *)bench_batch_receiver, &recv_args);
+        pthread_create(&sender, NULL, (void *)bench_batch_sender, &send_args);
+        pthread_join(sender, NULL);
+        pthread_join(receiver, NULL);
+        t = getTime() - t;
+        getrusage(RUSAGE_SELF, &usage2);
+
+        double cpu = (double)(usage2.ru_utime.tv_sec - usage1.ru_utime.tv_sec + usage2.ru_stime.tv_sec - usage1.ru_stime.tv_sec)
+            + (double)(usage2.ru_utime.tv_usec - usage1.ru_utime.tv_usec + usage2.ru_stime.tv_usec - usage1.ru_stime.tv_usec) / 1e6;
+        printf("  %6zu %11.1f ns %11.1f ns\n", batches[k], convertTimeToSeconds(t) * 1e9 / (double)count,
+               cpu * 1e9 / (double)count);
+        mu_assert("test_stress_send_recv_batch: Messages lost or out of order",
+                  send_args.bench.errors == 0 && recv_args.bench.errors == 0);
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+
+    // non-blocking batches move what fits and report the rest
+    channel_t* channel = channel_create(4);
+    void* items[6] = {"Message1", "Message2", "Message3", "Message4", "Message5", "Message6"};
+    void* out[6];
+    size_t n = 0;
+    mu_assert("test_stress_send_recv_batch: Batch send failed", channel_non_blocking_send_batch(channel, items, 6, &n) == SUCCESS);
+    mu_assert("test_stress_send_recv_batch: Batch send overfilled the channel", n == 4);
+    mu_assert("test_stress_send_recv_batch: Batch send to a full channel succeeded", channel_non_blocking_send_batch(channel, items, 6, &n) == CHANNEL_FULL && n == 0);
+    mu_assert("test_stress_send_recv_batch: Batch receive failed", channel_non_blocking_receive_batch(channel, out, 6, &n) == SUCCESS);
+    mu_assert("test_stress_send_recv_batch: Batch receive returned the wrong count", n == 4);
+    mu_assert("test_stress_send_recv_batch: Invalid message", string_equal(out[0], "Message1") && string_equal(out[3], "Message4"));
+    mu_assert("test_stress_send_recv_batch: Batch receive from an empty channel succeeded", channel_non_blocking_receive_batch(channel, out, 6, &n) == CHANNEL_EMPTY && n == 0);
+    mu_assert("test_stress_send_recv_batch: Empty blocking batch send was accepted", channel_send_batch(channel, items, 0, &n) == GENERIC_ERROR);
+    mu_assert("test_stress_send_recv_batch: Empty batch send was accepted", channel_non_blocking_send_batch(channel, items, 0, &n) == GENERIC_ERROR);
+
+    // a sender blocked mid-batch must see close and report how far it got
+    batch_args send_args = {{channel, 6, 0, 0}, 6};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)bench_batch_sender, &send_args);
+    usleep(10000);
+    mu_assert("test_stress_send_recv_batch: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_stress_send_recv_batch: Blocked batch send did not fail on close", send_args.bench.errors == 1);
+    mu_assert("test_stress_send_recv_batch: Batch send did not return CLOSED_ERROR", channel_send_batch(channel, items, 1, &n) == CLOSED_ERROR && n == 0);
+    mu_assert("test_stress_send_recv_batch: Batch receive did not drain before CLOSED_ERROR", channel_receive_batch(channel, out, 6, &n) == SUCCESS && n == 4);
+    mu_assert("test_stress_send_recv_batch: Batch receive did not return CLOSED_ERROR", channel_receive_batch(channel, out, 6, &n) == CLOSED_ERROR);
+    channel_destroy(channel);
+    return NULL;
+}
+
+typedef struct {
+    channel_t *channel;
+    size_t count;
+    uint64_t gap;
+    uint64_t *latency;
+    size_t errors;
+} latency_args;
+
+void* latency_sender(latency_args *myargs) {
+    for (size_t i = 0; i < myargs->count; i++) {
+        if (channel_send(myargs->channel, (void*)getTime()) != SUCCESS) {
+            myargs->errors++;
+        }
+        // a burst of work, so the receiver finds the channel empty and has to wait
+        uint64_t until = getTime() + myargs->gap;
+        while (getTime() < until) {
+        }
+    }
+    return NULL;
+}
+
+void* latency_receiver(latency_args *myargs) {
+    void* data = NULL;
+    uint64_t last = 0;
+    for (size_t i = 0; i < myargs->count; i++) {
+        if (channel_receive(myargs->channel, &data) != SUCCESS) {
+            myargs->errors++;
+            break;
+        }
+        // the send times must come out in the order they went in
+        if ((uint64_t)data < last) {
+            myargs->errors++;
+        }
+        last = (uint64_t)data;
+        myargs->latency[i] = getTime() - (uint64_t)data;
+    }
+    return NULL;
+}
+
+int compare_latency(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+char* test_handoff_latency() {
+    print_test_details(__func__, "Benchmarking p50/p99 handoff latency with and without adaptive waiting");
+    size_t counts[] = {20000, 5000};
+    uint64_t gaps[] = {2000, 50000};
+    enum channel_mode modes[] = {CHANNEL_SPSC, CHANNEL_MPMC};
+    const char* names[] = {"spsc", "mpmc"};
+    uint64_t* latency = malloc(counts[0] * sizeof(uint64_t));
+    bool one_cpu = sysconf(_SC_NPROCESSORS_ONLN) == 1;
+
+    if (one_cpu) {
+        printf("  one CPU online: spin_limit is 0, so adaptive on and off both park at once\n");
+    }
+    printf("  %4s %8s %8s %10s %10s %6s\n", "mode", "gap", "adaptive", "p50", "p99", "spin");
+    for (size_t m = 0; m < 2; m++) {
+        for (size_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+            for (int adaptive = 0; adaptive <= 1; adaptive++) {
+                channel_t* channel = channel_create_mode(1, modes[m]);
+                channel_set_adaptive_wait(channel, adaptive);
+                uint32_t spin_start = channel->spin_limit;
+                latency_args send_args = {channel, counts[g], gaps[g], NULL, 0};
+                latency_args recv_args = send_args;
+                recv_args.latency = latency;
+                pthread_t sender, receiver;
+                pthread_create(&receiver, NULL, (void *)latency_receiver, &recv_args);
+                pthread_create(&sender, NULL, (void *)latency_sender, &send_args);
+                pthread_join(sender, NULL);
+                pthread_join(receiver, NULL);
+                mu_assert("test_handoff_latency: Send or receive failed, or messages out of order", send_args.errors == 0 && recv_args.errors == 0);
+                // the spin budget is only tuned by waits that spin
+                if (one_cpu) {
+                    mu_assert("test_handoff_latency: Spun on a single CPU", channel->spin_limit == 0);
+                } else if (!adaptive) {
+                    mu_assert("test_handoff_latency: Spin limit tuned with adaptive waiting off", channel->spin_limit == spin_start);
+                } else {
+                    mu_assert("test_handoff_latency: Spin limit tuned down to nothing", channel->spin_limit > 0);
+                }
+
+                size_t n = send_args.count;
+                qsort(latency, n, sizeof(uint64_t), compare_latency);
+                printf("  %4s %5.0f us %8s %7.2f us %7.2f us %6u\n", names[m], (double)gaps[g] / 1e3,
+                       adaptive ? "on" : "off", (double)latency[n / 2] / 1e3, (double)latency[n * 99 / 100] / 1e3,
+                       channel->spin_limit);
+                channel_close(channel);
+                channel_destroy(channel);
+            }
+        }
+    }
+    free(latency);
+    return NULL;
+}
+
+typedef struct {
+    channel_t *ping;
+    channel_t *pong;
+    size_t count;
+    size_t errors;
+} pingpong_args;
+
+void* bench_ponger(pingpong_args *myargs) {
+    void* data = NULL;
+    for (size_t i = 0; i < myargs->count; i++) {
+        if (channel_receive(myargs->ping, &data) != SUCCESS || channel_send(myargs->pong, data) != SUCCESS) {
+            myargs->errors++;
+        }
+    }
+    return NULL;
+}
+
+char* test_rendezvous() {
+    print_test_details(__func__, "Testing unbuffered channels and benchmarking request/response handoff");
+    size_t count = 50000;
+    size_t capacities[] = {0, 1};
+
+    printf("  %8s %14s %16s\n", "capacity", "round trip", "switches per msg");
+    for (size_t k = 0; k < sizeof(capacities) / sizeof(capacities[0]); k++) {
+        pingpong_args args = {channel_create(capacities[k]), channel_create(capacities[k]), count, 0};
+        pthread_t pid;
+        void* data = NULL;
+
+        struct rusage usage1, usage2;
+        getrusage(RUSAGE_SELF, &usage1);
+        uint64_t t = getTime();
+        pthread_create(&pid, NULL, (void *)bench_ponger, &args);
+        for (size_t i = 1; i <= count; i++) {
+            if (channel_send(args.ping, (void*)i) != SUCCESS || channel_receive(args.pong, &data) != SUCCESS
+                || (size_t)data != i) {
+                args.errors++;
+            }
+        }
+        pthread_join(pid, NULL);
+        t = getTime() - t;
+        getrusage(RUSAGE_SELF, &usage2);
+
+        long switches = usage2.ru_nvcsw - usage1.ru_nvcsw + usage2.ru_nivcsw - usage1.ru_nivcsw;
+        printf("  %8zu %11.2f us %16.2f\n", capacities[k], convertTimeToSeconds(t) * 1e6 / (double)count,
+               (double)switches / (double)(2 * count));
+        mu_assert("test_rendezvous: Messages lost or out of order", args.errors == 0);
+        channel_close(args.ping);
+        channel_destroy(args.ping);
+        channel_close(args.pong);
+        channel_destroy(args.pong);
+    }
+
+    // nothing is buffered, so non-blocking calls only succeed against a parked peer
+    channel_t* channel = channel_create(0);
+    void* data = NULL;
+    mu_assert("test_rendezvous: Could not create channel", channel != NULL && channel->buffer != NULL);
+    mu_assert("test_rendezvous: Send without a receiver succeeded", channel_non_blocking_send(channel, "Message1") == CHANNEL_FULL);
+    mu_assert("test_rendezvous: Receive without a sender succeeded", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    receive_args recv;
+    pthread_t pid;
+    init_object_for_receive_api(&recv, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &recv);
+    usleep(10000);
+    mu_assert("test_rendezvous: Send to a parked receiver failed", channel_non_blocking_send(channel, "Message1") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_rendezvous: Parked receiver failed", recv.out == SUCCESS && string_equal(recv.data, "Message1"));
+
+    send_args send;
+    init_object_for_send_api(&send, channel, "Message2", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &send);
+    usleep(10000);
+    select_t list[1] = {{channel, RECV, NULL}};
+    size_t index = 1;
+    mu_assert("test_rendezvous: Select on a parked sender failed", channel_select(list, 1, &index) == SUCCESS && index == 0);
+    pthread_join(pid, NULL);
+    mu_assert("test_rendezvous: Parked sender failed", send.out == SUCCESS && string_equal(list[0].data, "Message2"));
+
+    // a parked sender must see close
+    init_object_for_send_api(&send, channel, "Message3", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &send);
+    usleep(10000);
+    mu_assert("test_rendezvous: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_rendezvous: Send did not return CLOSED_ERROR", send.out == CLOSED_ERROR);
+    mu_assert("test_rendezvous: Receive did not return CLOSED_ERROR", channel_receive(channel, &data) == CLOSED_ERROR);
+    channel_destroy(channel);
+    return NULL;
+}
+
+// Counts the threads parked on a handoff queue of an unbuffered channel
+static size_t handoff_parked(channel_t* channel, handoff_queue_t* queue) {
+    size_t count = 0;
+    pthread_mutex_lock(&channel->lock);
+    for (handoff_t* handoff = queue->head; handoff; handoff = handoff->next) {
+        count++;
+    }
+    pthread_mutex_unlock(&channel->lock);
+    return count;
+}
+
+char* test_rendezvous_close() {
+    print_test_details(__func__, "Testing close with several parked senders and receivers");
+    size_t THREADS = 8;
+
+    channel_t* send_channel = channel_create(0);
+    channel_t* recv_channel = channel_create(0);
+    send_args send[THREADS];
+    receive_args recv[THREADS];
+    pthread_t send_pid[THREADS], recv_pid[THREADS];
+
+    for (size_t i = 0; i < THREADS; i++) {
+        init_object_for_send_api(&send[i], send_channel, "Message1", NULL);
+        pthread_create(&send_pid[i], NULL, (void *)helper_send, &send[i]);
+        init_object_for_receive_api(&recv[i], recv_channel, NULL);
+        pthread_create(&recv_pid[i], NULL, (void *)helper_receive, &recv[i]);
+    }
+    while (handoff_parked(send_channel, &send_channel->senders) < THREADS ||
+           handoff_parked(recv_channel, &recv_channel->receivers) < THREADS) {
+        usleep(1000);
+    }
+
+    mu_assert("test_rendezvous_close: Close failed", channel_close(send_channel) == SUCCESS);
+    mu_assert("test_rendezvous_close: Close failed", channel_close(recv_channel) == SUCCESS);
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(send_pid[i], NULL);
+        pthread_join(recv_pid[i], NULL);
+        mu_assert("test_rendezvous_close: Parked send did not return CLOSED_ERROR", send[i].out == CLOSED_ERROR);
+        mu_assert("test_rendezvous_close: Parked receive did not return CLOSED_ERROR", recv[i].out == CLOSED_ERROR);
+    }
+    mu_assert("test_rendezvous_close: Close left senders queued", send_channel->senders.head == NULL && send_channel->senders.tail == NULL);
+    mu_assert("test_rendezvous_close: Close left receivers queued", recv_channel->receivers.head == NULL && recv_channel->receivers.tail == NULL);
+
+    channel_destroy(send_channel);
+    channel_destroy(recv_channel);
+    return NULL;
+}
+
+#define SHARED_MSG_SIZE 64
+
+// Writes or reads one SHARED_MSG_SIZE message on a byte stream, retrying partial transfers
+bool stream_write(int fd, const char* msg) {
+    for (size_t done = 0; done < SHARED_MSG_SIZE; ) {
+        ssize_t n = write(fd, msg + done, SHARED_MSG_SIZE - done);
+        if (n <= 0) {
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return true;
+}
+
+bool stream_read(int fd, char* msg) {
+    for (size_t done = 0; done < SHARED_MSG_SIZE; ) {
+        ssize_t n = read(fd, msg + done, SHARED_MSG_SIZE - done);
+        if (n <= 0) {
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return true;
+}
+
+// Each message starts with its sequence number, the child exits with the number of bad messages
+int shared_child(shared_channel_t* channel, int fd, size_t count) {
+    char msg[SHARED_MSG_SIZE];
+    int errors = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool ok = channel ? channel_shared_receive(channel, msg) == SUCCESS : stream_read(fd, msg);
+        size_t seq;
+        memcpy(&seq, msg, sizeof(seq));
+        if (!ok || seq != i) {
+            errors = 1;
+            break;
+        }
+    }
+    if (channel) {
+        // the parent closes after its last send, so this drains to CLOSED_ERROR
+        if (channel_shared_receive(channel, msg) != CLOSED_ERROR) {
+            errors = 1;
+        }
+        channel_shared_detach(channel);
+    }
+    return errors;
+}
+
+// Sends count messages from this process to a forked child, returns messages per second or -1 on errors
+// channel is reopened by name in the child, otherwise fds[0] is read by the child and fds[1] written here
+double shared_bench(const char* name, size_t capacity, int* fds, size_t count) {
+    char msg[SHARED_MSG_SIZE] = {0};
+    fflush(stdout);
+    uint64_t t = getTime();
+    pid_t pid = fork();
+    if (pid == 0) {
+        shared_channel_t* channel = name ? channel_open_shared(name, capacity, SHARED_MSG_SIZE) : NULL;
+        if (fds) {
+            close(fds[1]);
+        }
+        _exit((name && !channel) ? 1 : shared_child(channel, fds ? fds[0] : -1, count));
+    }
+    shared_channel_t* channel = name ? channel_open_shared(name, capacity, SHARED_MSG_SIZE) : NULL;
+    if (fds) {
+        close(fds[0]);
+    }
+    bool ok = !name || channel;
+    for (size_t i = 0; ok && i < count; i++) {
+        memcpy(msg, &i, sizeof(i));
+        ok = channel ? channel_shared_send(channel, msg) == SUCCESS : stream_write(fds[1], msg);
+    }
+    if (channel) {
+        channel_shared_close(channel);
+        channel_shared_detach(channel);
+    } else {
+        close(fds[1]);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    t = getTime() - t;
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return (double)count / convertTimeToSeconds(t);
+}
+
+char* test_shared_channel() {
+    print_test_details(__func__, "Testing cross-process channels and benchmarking against pipes and Unix sockets");
+    char name[64];
+    snprintf(name, sizeof(name), "/channel_test_%d", (int)getpid());
+    size_t count = 100000;
+    size_t capacity = 64;
+    char msg[SHARED_MSG_SIZE] = "Message";
+    char out[SHARED_MSG_SIZE];
+
+    // same-process checks
+    channel_unlink_shared(name);
+    shared_channel_t* channel = channel_open_shared(name, 2, SHARED_MSG_SIZE);
+    mu_assert("test_shared_channel: Could not open channel", channel != NULL);
+    mu_assert("test_shared_channel: Opened with a different msg_size", channel_open_shared(name, 2, 32) == NULL);
+    mu_assert("test_shared_channel: Opened with a different capacity", channel_open_shared(name, 4, SHARED_MSG_SIZE) == NULL);
+    shared_channel_t* other = channel_open_shared(name, 2, SHARED_MSG_SIZE);
+    mu_assert("test_shared_channel: Could not reopen channel", other != NULL);
+    mu_assert("test_shared_channel: Send failed", channel_shared_non_blocking_send(channel, msg) == SUCCESS);
+    mu_assert("test_shared_channel: Send failed", channel_shared_send(channel, msg) == SUCCESS);
+    mu_assert("test_shared_channel: Send to a full channel succeeded", channel_shared_non_blocking_send(channel, msg) == CHANNEL_FULL);
+    mu_assert("test_shared_channel: Receive through the second mapping failed", channel_shared_non_blocking_receive(other, out) == SUCCESS);
+    mu_assert("test_shared_channel: Invalid message", string_equal(out, "Message"));
+    mu_assert("test_shared_channel: Close failed", channel_shared_close(other) == SUCCESS);
+    mu_assert("test_shared_channel: Send did not return CLOSED_ERROR", channel_shared_send(channel, msg) == CLOSED_ERROR);
+    mu_assert("test_shared_channel: Receive did not drain before CLOSED_ERROR", channel_shared_receive(channel, out) == SUCCESS);
+    mu_assert("test_shared_channel: Receive did not return CLOSED_ERROR", channel_shared_receive(channel, out) == CLOSED_ERROR);
+    channel_shared_detach(other);
+    channel_shared_detach(channel);
+    mu_assert("test_shared_channel: Unlink failed", channel_unlink_shared(name) == SUCCESS);
+
+    // one process to another, 64 byte messages
+    printf("  %-12s %12s\n", "transport", "throughput");
+    double rate = shared_bench(name, capacity, NULL, count);
+    channel_unlink_shared(name);
+    mu_assert("test_shared_channel: Messages lost or out of order across processes", rate > 0);
+    printf("  %-12s %6.2f Mmsg/s\n", "shared", rate / 1e6);
+
+    int fds[2];
+    mu_assert("test_shared_channel: pipe failed", pipe(fds) == 0);
+    rate = shared_bench(NULL, 0, fds, count);
+    mu_assert("test_shared_channel: Messages lost over the pipe", rate > 0);
+    printf("  %-12s %6.2f Mmsg/s\n", "pipe", rate / 1e6);
+
+    mu_assert("test_shared_channel: socketpair failed", socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    rate = shared_bench(NULL, 0, fds, count);
+    mu_assert("test_shared_channel: Messages lost over the socket", rate > 0);
+    printf("  %-12s %6.2f Mmsg/s\n", "unix socket", rate / 1e6);
+    return NULL;
+}
+
+typedef struct {
+    const char* name;
+    size_t capacity;
+    shared_channel_t* out;
+} stale_open_args;
+
+void* stale_opener(stale_open_args* myargs) {
+    myargs->out = channel_open_shared(myargs->name, myargs->capacity, SHARED_MSG_SIZE);
+    return NULL;
+}
+
+// Leaves name behind as a creator that died after shm_open and ftruncate to size
+static bool make_stale(const char* name, size_t size) {
+    channel_unlink_shared(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = ftruncate(fd, (off_t)size) == 0;
+    close(fd);
+    return ok;
+}
+
+char* test_shared_channel_stale() {
+    print_test_details(__func__, "Testing opening a shared channel whose creator never initialized it");
+    char name[64];
+    snprintf(name, sizeof(name), "/channel_stale_%d", (int)getpid());
+    size_t capacity = 4;
+    size_t sizes[] = {0, sizeof(shared_segment_t) + capacity * SHARED_MSG_SIZE};
+    char msg[SHARED_MSG_SIZE] = "Message";
+    char out[SHARED_MSG_SIZE];
+
+    // a creator that died before sizing the segment, then one that died before publishing ready
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        mu_assert("test_shared_channel_stale: Could not make a stale segment", make_stale(name, sizes[k]));
+
+        uint64_t t = getTime();
+        mu_assert("test_shared_channel_stale: Opened a channel that was never initialized", channel_open_shared(name, capacity, SHARED_MSG_SIZE) == NULL);
+        t = getTime() - t;
+        mu_assert("test_shared_channel_stale: Open did not give up within a few seconds", convertTimeToSeconds(t) < 5);
+
+        // the opener leaves the name alone, unlinking it lets the next open create a working channel
+        mu_assert("test_shared_channel_stale: Stale name was removed by the opener", channel_unlink_shared(name) == SUCCESS);
+        shared_channel_t* channel = channel_open_shared(name, capacity, SHARED_MSG_SIZE);
+        mu_assert("test_shared_channel_stale: Could not create a channel over the stale name", channel != NULL);
+        mu_assert("test_shared_channel_stale: Send failed", channel_shared_non_blocking_send(channel, msg) == SUCCESS);
+        mu_assert("test_shared_channel_stale: Receive failed", channel_shared_non_blocking_receive(channel, out) == SUCCESS && string_equal(out, "Message"));
+        channel_shared_detach(channel);
+        mu_assert("test_shared_channel_stale: Unlink failed", channel_unlink_shared(name) == SUCCESS);
+    }
+
+    // a new creator takes over the name while an opener still waits on the stale segment;
+    // the opener's timeout must not take the name from the new channel
+    mu_assert("test_shared_channel_stale: Could not make a stale segment", make_stale(name, 0));
+    stale_open_args args = {name, capacity, NULL};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)stale_opener, &args);
+    usleep(100000);
+    mu_assert("test_shared_channel_stale: Unlink failed", channel_unlink_shared(name) == SUCCESS);
+    shared_channel_t* creator = channel_open_shared(name, capacity, SHARED_MSG_SIZE);
+    mu_assert("test_shared_channel_stale: Could not create the new channel", creator != NULL);
+    mu_assert("test_shared_channel_stale: Send failed", channel_shared_non_blocking_send(creator, msg) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_shared_channel_stale: Opener attached to the stale segment", args.out == NULL);
+
+    shared_channel_t* opener = channel_open_shared(name, capacity, SHARED_MSG_SIZE);
+    mu_assert("test_shared_channel_stale: Could not open the new channel", opener != NULL);
+    mu_assert("test_shared_channel_stale: Message sent by the new creator was lost", channel_shared_non_blocking_receive(opener, out) == SUCCESS && string_equal(out, "Message"));
+    channel_shared_detach(opener);
+    channel_shared_detach(creator);
+    mu_assert("test_shared_channel_stale: Unlink failed", channel_unlink_shared(name) == SUCCESS);
+    return NULL;
+}
+
+#define BYTE_MSG_MIN 16
+#define BYTE_MSG_SPREAD 241
+
+// Message i is BYTE_MSG_MIN to BYTE_MSG_MIN + 240 bytes: its sequence number, then bytes equal to i
+size_t byte_msg_len(size_t i) {
+    return BYTE_MSG_MIN + (i * 37) % BYTE_MSG_SPREAD;
+}
+
+void byte_msg_fill(unsigned char* msg, size_t i, size_t len) {
+    memcpy(msg, &i, sizeof(i));
+    memset(msg + sizeof(i), (int)(i & 0xff), len - sizeof(i));
+}
+
+bool byte_msg_check(const unsigned char* msg, size_t i, size_t len) {
+    size_t seq;
+    memcpy(&seq, msg, sizeof(seq));
+    return len == byte_msg_len(i) && seq == i && msg[len - 1] == (unsigned char)(i & 0xff);
+}
+
+typedef struct {
+    byte_channel_t* bytes;  // zero-copy ring, or NULL to send malloc'd copies over channel
+    channel_t* channel;
+    size_t count;
+    bool ok;
+} byte_bench_args;
+
+void* byte_bench_sender(void* arg) {
+    byte_bench_args* args = arg;
+    unsigned char scratch[BYTE_MSG_MIN + BYTE_MSG_SPREAD];
+    args->ok = true;
+    for (size_t i = 0; args->ok && i < args->count; i++) {
+        size_t len = byte_msg_len(i);
+        if (args->bytes) {
+            void* region;
+            args->ok = byte_channel_reserve(args->bytes, len, &region) == SUCCESS;
+            if (args->ok) {
+                byte_msg_fill(region, i, len);
+                args->ok = byte_channel_commit(args->bytes, len) == SUCCESS;
+            }
+        } else {
+            // what a void* channel needs: build the message, copy it to the heap, pass the pointer and length
+            byte_msg_fill(scratch, i, len);
+            size_t* copy = malloc(sizeof(size_t) + len);
+            copy[0] = len;
+            memcpy(copy + 1, scratch, len);
+            args->ok = channel_send(args->channel, copy) == SUCCESS;
+        }
+    }
+    return NULL;
+}
+
+void* byte_bench_receiver(void* arg) {
+    byte_bench_args* args = arg;
+    args->ok = true;
+    for (size_t i = 0; args->ok && i < args->count; i++) {
+        if (args->bytes) {
+            void* region;
+            size_t len;
+            args->ok = byte_channel_peek(args->bytes, &region, &len) == SUCCESS
+                && byte_msg_check(region, i, len)
+                && byte_channel_release(args->bytes) == SUCCESS;
+        } else {
+            void* data;
+            args->ok = channel_receive(args->channel, &data) == SUCCESS;
+            if (args->ok) {
+                size_t* copy = data;
+                args->ok = byte_msg_check((unsigned char*)(copy + 1), i, copy[0]);
+                free(copy);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Returns messages per second for count variable-length messages from one thread to another, or -1 on errors
+double byte_bench(byte_channel_t* bytes, channel_t* channel, size_t count) {
+    byte_bench_args send = {bytes, channel, count, false};
+    byte_bench_args recv = {bytes, channel, count, false};
+    pthread_t sender, receiver;
+    uint64_t t = getTime();
+    pthread_create(&receiver, NULL, byte_bench_receiver, &recv);
+    pthread_create(&sender, NULL, byte_bench_sender, &send);
+    pthread_join(sender, NULL);
+    pthread_join(receiver, NULL);
+    t = getTime() - t;
+    return (send.ok && recv.ok) ? (double)count / convertTimeToSeconds(t) : -1;
+}
+
+char* test_byte_channel() {
+    print_test_details(__func__, "Testing the zero-copy byte channel and benchmarking against malloc'd messages");
+    size_t count = 200000;
+    void* region;
+    void* other;
+    size_t len;
+
+    mu_assert("test_byte_channel: Created a ring below 64 bytes", byte_channel_create(32) == NULL);
+    byte_channel_t* bytes = byte_channel_create(100);
+    mu_assert("test_byte_channel: Could not create channel", bytes != NULL);
+    // 128 byte ring, messages up to 56 bytes
+    mu_assert("test_byte_channel: Reserved more than half the ring", byte_channel_reserve(bytes, 57, &region) == GENERIC_ERROR);
+    mu_assert("test_byte_channel: Peeked an empty ring", byte_channel_non_blocking_peek(bytes, &region, &len) == CHANNEL_EMPTY);
+    mu_assert("test_byte_channel: Reserve failed", byte_channel_reserve(bytes, 56, &region) == SUCCESS);
+    mu_assert("test_byte_channel: Reserved twice", byte_channel_reserve(bytes, 8, &other) == GENERIC_ERROR);
+    mu_assert("test_byte_channel: Committed more than was reserved", byte_channel_commit(bytes, 57) == GENERIC_ERROR);
+    memcpy(region, "Message", 8);
+    mu_assert("test_byte_channel: Commit failed", byte_channel_commit(bytes, 8) == SUCCESS);
+    mu_assert("test_byte_channel: Committed twice", byte_channel_commit(bytes, 8) == GENERIC_ERROR);
+    // the short commit gave back 48 bytes, so two more 40 byte messages fit but a third does not
+    mu_assert("test_byte_channel: Reserve failed", byte_channel_non_blocking_reserve(bytes, 40, &other) == SUCCESS);
+    mu_assert("test_byte_channel: Commit failed", byte_channel_commit(bytes, 40) == SUCCESS);
+    mu_assert("test_byte_channel: Reserve failed", byte_channel_non_blocking_reserve(bytes, 40, &other) == SUCCESS);
+    mu_assert("test_byte_channel: Commit failed", byte_channel_commit(bytes, 40) == SUCCESS);
+    mu_assert("test_byte_channel: Reserved in a full ring", byte_channel_non_blocking_reserve(bytes, 40, &other) == CHANNEL_FULL);
+    mu_assert("test_byte_channel: Peek failed", byte_channel_peek(bytes, &other, &len) == SUCCESS);
+    mu_assert("test_byte_channel: Peek copied the message", other == region);
+    mu_assert("test_byte_channel: Invalid message", len == 8 && string_equal(other, "Message"));
+    mu_assert("test_byte_channel: Peeked twice", byte_channel_peek(bytes, &other, &len) == GENERIC_ERROR);
+    mu_assert("test_byte_channel: Release failed", byte_channel_release(bytes) == SUCCESS);
+    mu_assert("test_byte_channel: Released twice", byte_channel_release(bytes) == GENERIC_ERROR);
+    mu_assert("test_byte_channel: Peek failed", byte_channel_non_blocking_peek(bytes, &other, &len) == SUCCESS);
+    mu_assert("test_byte_channel: Release failed", byte_channel_release(bytes) == SUCCESS);
+    // 16 bytes free at the end and 64 at the start, a 16 byte message goes to the start past a wrap header
+    mu_assert("test_byte_channel: Reserve across the end of the ring failed", byte_channel_non_blocking_reserve(bytes, 16, &region) == SUCCESS);
+    memcpy(region, "Wrapped", 8);
+    mu_assert("test_byte_channel: Commit failed", byte_channel_commit(bytes, 16) == SUCCESS);
+    mu_assert("test_byte_channel: Peek failed", byte_channel_non_blocking_peek(bytes, &other, &len) == SUCCESS);
+    mu_assert("test_byte_channel: Invalid message", len == 40);
+    mu_assert("test_byte_channel: Release failed", byte_channel_release(bytes) == SUCCESS);
+    mu_assert("test_byte_channel: Peek past the wrap failed", byte_channel_non_blocking_peek(bytes, &other, &len) == SUCCESS);
+    mu_assert("test_byte_channel: Invalid wrapped message", other == region && len == 16 && string_equal(other, "Wrapped"));
+    mu_assert("test_byte_channel: Release failed", byte_channel_release(bytes) == SUCCESS);
+    mu_assert("test_byte_channel: Reserve failed", byte_channel_reserve(bytes, 8, &region) == SUCCESS);
+    mu_assert("test_byte_channel: Commit failed", byte_channel_commit(bytes, 8) == SUCCESS);
+    mu_assert("test_byte_channel: Destroyed an open channel", byte_channel_destroy(bytes) == DESTROY_ERROR);
+    mu_assert("test_byte_channel: Close failed", byte_channel_close(bytes) == SUCCESS);
+    mu_assert("test_byte_channel: Closed twice", byte_channel_close(bytes) == CLOSED_ERROR);
+    mu_assert("test_byte_channel: Reserve did not return CLOSED_ERROR", byte_channel_reserve(bytes, 8, &region) == CLOSED_ERROR);
+    mu_assert("test_byte_channel: Peek did not drain before CLOSED_ERROR", byte_channel_peek(bytes, &other, &len) == SUCCESS);
+    mu_assert("test_byte_channel: Release failed", byte_channel_release(bytes) == SUCCESS);
+    mu_assert("test_byte_channel: Peek did not return CLOSED_ERROR", byte_channel_peek(bytes, &other, &len) == CLOSED_ERROR);
+    mu_assert("test_byte_channel: Destroy failed", byte_channel_destroy(bytes) == SUCCESS);
+
+    // one thread to another, 16 to 256 byte messages
+    printf("  %-22s %12s %12s\n", "transport", "throughput", "bandwidth");
+    double mean_len = BYTE_MSG_MIN + (BYTE_MSG_SPREAD - 1) / 2.0;
+    bytes = byte_channel_create(64 * 1024);
+    mu_assert("test_byte_channel: Could not create channel", bytes != NULL);
+    double rate = byte_bench(bytes, NULL, count);
+    mu_assert("test_byte_channel: Messages lost or corrupted in the byte channel", rate > 0);
+    printf("  %-22s %6.2f Mmsg/s %7.0f MB/s\n", "byte channel", rate / 1e6, rate * mean_len / 1e6);
+    byte_channel_close(bytes);
+    byte_channel_destroy(bytes);
+
+    enum channel_mode modes[] = {CHANNEL_LOCKED, CHANNEL_SPSC};
+    const char* names[] = {"malloc + locked", "malloc + SPSC"};
+    for (size_t m = 0; m < 2; m++) {
+        // same number of queued messages as the byte ring holds on average
+        channel_t* channel = channel_create_mode(256, modes[m]);
+        rate = byte_bench(NULL, channel, count);
+        mu_assert("test_byte_channel: Messages lost or corrupted in the channel", rate > 0);
+        printf("  %-22s %6.2f Mmsg/s %7.0f MB/s\n", names[m], rate / 1e6, rate * mean_len / 1e6);
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+    return NULL;
+}
+
+char* test_select_benchmark() {
+    print_test_details(__func__, "Benchmarking select receiving from many channels");
+    size_t count = 19200;
+    size_t sizes[] = {1, 4, 16, 64};
+
+    printf("  %8s %12s %14s\n", "channels", "throughput", "cpu per msg");
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        size_t n = sizes[k];
+        channel_t* channel[n];
+        select_t list[n];
+        pthread_t pid[n];
+        bench_args args[n];
+        size_t errors = 0, sum = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            channel[i] = channel_create(1);
+            list[i].channel = channel[i];
+            list[i].dir = RECV;
+            args[i] = (bench_args){channel[i], count / n, 0, 0};
+        }
+
+        struct rusage usage1, usage2;
+        getrusage(RUSAGE_SELF, &usage1);
+        uint64_t t = getTime();
+        for (size_t i = 0; i < n; i++) {
+            pthread_create(&pid[i], NULL, (void *)bench_sender, &args[i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t index = n;
+            if (channel_select(list, n, &index) != SUCCESS || index >= n) {
+                errors++;
+                break;
+            }
+            sum += (size_t)list[index].data;
+        }
+        for (size_t i = 0; i < n; i++) {
+            pthread_join(pid[i], NULL);
+            errors += args[i].errors;
+        }
+        t = getTime() - t;
+        getrusage(RUSAGE_SELF, &usage2);
+
+        double cpu = (double)(usage2.ru_utime.tv_sec - usage1.ru_utime.tv_sec + usage2.ru_stime.tv_sec - usage1.ru_stime.tv_sec)
+            + (double)(usage2.ru_utime.tv_usec - usage1.ru_utime.tv_usec + usage2.ru_stime.tv_usec - usage1.ru_stime.tv_usec) / 1e6;
+        printf("  %8zu %6.3f Mmsg/s %11.2f us\n", n, (double)count / convertTimeToSeconds(t) / 1e6,
+               cpu * 1e6 / (double)count);
+        size_t per_sender = count / n;
+        mu_assert("test_select_benchmark: Select failed", errors == 0);
+        mu_assert("test_select_benchmark: Messages lost or duplicated", sum == n * per_sender * (per_sender + 1) / 2);
+
+        for (size_t i = 0; i < n; i++) {
+            channel_close(channel[i]);
+            channel_destroy(channel[i]);
+        }
+    }
+    return NULL;
+}
+
 char* test_cpu_utilization_overall() {
     print_test_details(__func__, "Testing overall CPU utilization (takes around 20 seconds)");
 
@@ -1649,6 +2757,16 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_multiple_channels", test_multiple_channels},
                   {"test_overall_send_receive", test_overall_send_receive},
                   {"test_stress_send_recv", test_stress_send_recv},
+                  {"test_stress_send_recv_spsc", test_stress_send_recv_spsc},
+                  {"test_stress_send_recv_mpmc", test_stress_send_recv_mpmc},
+                  {"test_stress_send_recv_unbounded", test_stress_send_recv_unbounded},
+                  {"test_stress_send_recv_batch", test_stress_send_recv_batch},
+                  {"test_rendezvous", test_rendezvous},
+                  {"test_rendezvous_close", test_rendezvous_close},
+                  {"test_handoff_latency", test_handoff_latency},
+                  {"test_shared_channel", test_shared_channel},
+                  {"test_shared_channel_stale", test_shared_channel_stale},
+                  {"test_byte_channel", test_byte_channel},
                   {"test_response_time", test_response_time},
                   {"test_cpu_utilization_send", test_cpu_utilization_send},
                   {"test_cpu_utilization_receive", test_cpu_utilization_receive},
@@ -1656,6 +2774,7 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_channel_close_with_receive", test_channel_close_with_receive},
                   {"test_select", test_select},
                   {"test_select_close", test_select_close},
+                  {"test_select_empty", test_select_empty},
                   {"test_select_and_non_blocking_send_size1", test_select_and_non_blocking_send_size1},
                   {"test_select_and_non_blocking_receive_size1", test_select_and_non_blocking_receive_size1},
                   {"test_select_with_select_size1", test_select_with_select_size1},
@@ -1664,6 +2783,7 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_select_with_duplicate_channel_size1", test_select_with_duplicate_channel_size1},
                   {"test_stress", test_stress},
                   {"test_select_response_time", test_select_response_time},
+                  {"test_select_benchmark", test_select_benchmark},
                   {"test_cpu_utilization_select", test_cpu_utilization_select},
                   {"test_cpu_utilization_overall", test_cpu_utilization_overall},
                   {"test_for_too_many_wakeups", test_for_too_many_wakeups},
@@ -7,9 +7,11 @@
  * Copyright (c) 2004-2016, R. Bryant and D. O'Hallaron, All rights
  * reserved.  May not be used, modified, or copied without permission.
  */
+#define _GNU_SOURCE             /* sched_setaffinity */
 #include <assert.h>
 #include <errno.h>
 #include <float.h>
+#include <limits.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -20,6 +22,9 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <math.h>
+#include <sys/resource.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include "mm.h"
 #include "memlib.h"
@@ -34,6 +39,8 @@
 /* Misc */
 #define MAXLINE     1024          /* max string size */
 #define HDRLINES       4          /* number of header lines in a trace file */
+#define MAX_REPS     101          /* most timed repetitions per trace (-r) */
+#define MAX_THREADS   64          /* most threads in a trace or replay (-n) */
 #define LINENUM(i) (i+HDRLINES+1) /* cnvt trace request nums to linenums (origin 1) */
 
 #ifndef REF_ONLY
@@ -83,14 +90,42 @@ typedef struct {
     enum { ALLOC, FREE, REALLOC } type; /* type of request */
     long index;                         /* index for free() to use later */
     size_t size;                        /* byte size of alloc/realloc request */
+    int tid;                            /* thread issuing the request */
+    int dep;                            /* request that must finish first, or -1 */
 } traceop_t;
 
+/*
+ * Binary traces, as written by mktrace.py -b: BIN_TRACE_MAGIC, a
+ * bin_header_t, then num_ops bin_op_t records, all little-endian
+ */
+#define BIN_TRACE_MAGIC "MMTRACE1"
+
+typedef struct {
+    uint32_t weight;
+    uint32_t num_ids;
+    uint32_t num_ops;
+    uint32_t reserved;
+    uint64_t data_bytes;
+} bin_header_t;
+
+typedef struct {
+    uint8_t type;                       /* 'a', 'r' or 'f' as in .rep files */
+    uint8_t tid;
+    uint16_t reserved;
+    int32_t dep;                        /* -1 for none */
+    int32_t index;
+    uint32_t reserved2;
+    uint64_t size;
+} bin_op_t;
+
 /* Holds the information for one trace file */
 typedef struct {
     char filename[MAXLINE];
     size_t data_bytes;    /* Peak number of data bytes allocated during trace */
     int num_ids;          /* number of alloc/realloc ids */
     int num_ops;          /* number of distinct requests */
+    int num_threads;      /* 1 + highest thread id, see traces/README */
+    bool threaded;        /* requests carry thread ids */
     weight_t weight;      /* weight for this trace */
     traceop_t *ops;       /* array of requests */
     char **blocks;        /* array of ptrs returned by malloc/realloc... */
@@ -120,6 +155,20 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;       /* space utilization for this trace (always 0 for libc) */
+    double rutil;      /* peak payload over peak resident heap bytes (-R) */
+    size_t resident;   /* peak resident heap bytes (-R) */
+    size_t avg_resident; /* mean of the resident samples (-R) */
+    long faults;       /* minor page faults during the utilization run (-R) */
+    long mm_faults;    /* of those, taken inside mm_malloc, mm_realloc and mm_free */
+    mm_stats_t heap;   /* mm_stats() at the end of the utilization run */
+
+    /* set with -r: throughput of each repetition, in Kops/s */
+    int reps;
+    double kops[MAX_REPS];
+    double kops_lo, kops_hi; /* 95% confidence interval of the median */
+
+    /* set with -B: per-operation latency percentiles, in ns */
+    double lat_p50, lat_p90, lat_p99;
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -159,6 +208,66 @@ int verbose = REF_ONLY ? 0 : 1;  /* global flag for verbose output */
 static int errors = 0;           /* number of errs found when running student malloc */
 static bool onetime_flag = false;
 static bool tab_mode = false;     /* Print output as tab-separated fields */
+static bool compare_classes = false; /* Rerun traces under each size-class table */
+static bool compare_growth = false; /* Rerun traces with realloc growth hints */
+static bool print_heap_stats = false; /* Print mm_stats() for each trace */
+static int check_interval = 0;   /* Incremental mm_checkheap every this many ops */
+static char *heap_file = NULL;   /* Back heaps with this file and test restores */
+static int huge_pages = MEM_PAGES_NORMAL; /* Rerun traces on huge pages if set */
+static bool measure_resident = false; /* Track resident heap pages in eval_mm_util */
+
+/* With -R, eval_mm_util samples mem_resident() every this many ops */
+#define RESIDENT_STRIDE 16
+
+/* With -R, blocks are touched like an application would, up to this size */
+#define RESIDENT_TOUCH_MAX (64ul << 20)
+#define UNTOUCHED(size) ((size) > RESIDENT_TOUCH_MAX ? (size) - RESIDENT_TOUCH_MAX : 0)
+
+/* Stability mode (-r): timed repetitions and untimed warm-up runs */
+static int repetitions = 0;
+static int warmups = 2;
+static int pin_cpu = -1;         /* CPU to pin to with -a, -1 for none */
+static char *json_file = NULL;   /* Write per-trace results here with -j */
+
+/* Historical results: append each run to db_file (-B), compare two runs (-G) */
+static char *db_file = NULL;
+static char *compare_spec = NULL;
+#define NOISE_FLOOR 0.02         /* smallest throughput change -G flags */
+#define UTIL_NOISE 0.001         /* util is deterministic; allow rounding only */
+
+/* Replay traces on this many threads with -n, 0 for none */
+static int replay_threads = 0;
+
+/* Heap map (-m): drawn from mm_heap_walk after op map_op, -1 for the last */
+static bool map_heap = false;
+static int map_op = -1;
+static char *map_prefix = NULL;  /* also write <prefix>-<trace>.ppm if set */
+#define MAP_COLS 64              /* text map is MAP_COLS x MAP_ROWS cells */
+#define MAP_ROWS 16
+#define MAP_PIXELS 256           /* image is MAP_PIXELS x MAP_PIXELS */
+typedef struct {
+    char *base;                  /* start of the heap */
+    size_t cell, pixel;          /* heap bytes per text cell, image pixel */
+    size_t blocks, free_blocks;
+    size_t alloc_bytes, free_bytes, largest_free;
+    size_t text[MAP_COLS * MAP_ROWS][2];    /* allocated, free bytes */
+    size_t image[MAP_PIXELS * MAP_PIXELS][2];
+} heap_map_t;
+
+/* Default -P decay: malloc/free calls a large block stays free before purging */
+#define PURGE_DECAY 1024
+
+/* Placement policies given with -p; the first one is used for scoring */
+#define MAX_POLICIES 16
+#define GOOD_FIT_K    8   /* candidates weighed by "good" without ":K" */
+typedef struct {
+    char name[32];
+    int fit;              /* one of the MM_FIT_* policies in mm.h */
+    int good_k;
+    bool addr_ordered;
+} policy_t;
+static policy_t policies[MAX_POLICIES];
+static int num_policies = 0;
 static size_t maxfill = MAXFILL;
 
 /* by default, no timeouts */
@@ -202,6 +311,9 @@ static void free_range_set(range_set_t *ranges);
 static void init_random_data(void);
 static bool check_index(const trace_t *trace, int opnum, int index, int realloc);
 static void randomize_block(trace_t *trace, int index);
+static void touch_block(char *p, size_t size);
+static long minor_faults(void);
+static void print_heap_map(const trace_t *trace, int opnum);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(stats_t *stats, const char *tracedir,
@@ -216,11 +328,36 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static bool eval_mm_valid(trace_t *trace, range_set_t *ranges);
-static double eval_mm_util(trace_t *trace, int tracenum);
+static double eval_mm_util(trace_t *trace, int tracenum, stats_t *stats);
+static bool eval_mm_restore(trace_t *trace);
 static void eval_mm_speed(void *ptr);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats, sum_stats_t *sumstats);
+static void print_comparison(int n, const char *title, const char **names,
+                             stats_t **stats, int nconfigs);
+static void print_mm_stats(int n, stats_t *stats);
+static void print_resident(int n, stats_t *stats);
+static int cmp_double(const void *a, const void *b);
+static void median_ci(int n, int *lo, int *hi);
+static void check_median_ci(void);
+static double measure_speed(stats_t *stats, speed_t *speed_params);
+static void print_stability(int n, stats_t *stats);
+static void write_json(const char *path, int n, stats_t *stats);
+static void eval_mm_latency(trace_t *trace, stats_t *stats);
+static void replay_trace(trace_t *trace, int nthreads);
+static void record_results(const char *path, int n, stats_t *stats);
+static int compare_results(char *spec);
+static bool get_cpu_type(char *cpu_type);
+static void compare_size_classes(int n, const char *tracedir, char **tracefiles,
+                                 speed_t *speed_params);
+static void compare_page_sizes(int n, const char *tracedir, char **tracefiles,
+                               speed_t *speed_params);
+static void compare_realloc_growth(int n, const char *tracedir, char **tracefiles,
+                                   speed_t *speed_params);
+static void parse_policies(char *arg);
+static void compare_policies(int n, const char *tracedir, char **tracefiles,
+                             speed_t *speed_params);
 static void usage(char *prog);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     __attribute__((format(printf, 3,4)));
@@ -247,7 +384,7 @@ static double measure_ref_throughput();
  */
 static void run_tests(int num_tracefiles, const char *tracedir,
                       char **tracefiles, 
-                      stats_t *mm_stats, speed_t *speed_params) {
+                      stats_t *stats, speed_t *speed_params) {
     volatile int i;
 
     for (i=0; i < num_tracefiles; i++) {
@@ -260,20 +397,20 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         // NOTE: If times out, then it will reread the trace file 
 
         trace_t *trace;
-        trace = read_trace(&mm_stats[i], tracedir, tracefiles[i]);
-        strcpy(mm_stats[i].filename, trace->filename);
-        mm_stats[i].ops = trace->num_ops;
+        trace = read_trace(&stats[i], tracedir, tracefiles[i]);
+        strcpy(stats[i].filename, trace->filename);
+        stats[i].ops = trace->num_ops;
 
         /* Prepare for timeout */
         if (set_timeout > 0) {
             alarm(set_timeout); 
         }
         if (sigsetjmp(timeout_jmpbuf, 1) != 0) {
-            mm_stats[i].valid = false;
+            stats[i].valid = false;
         } else {
             if (verbose > 1)
                 printf("Checking mm_malloc for correctness, ");
-            mm_stats[i].valid =
+            stats[i].valid =
                 /* Do 2 tests, since may fail to reinitialize properly */
                 eval_mm_valid(trace, ranges) && eval_mm_valid(trace, ranges);
 
@@ -282,14 +419,19 @@ static void run_tests(int num_tracefiles, const char *tracedir,
                 return;
             }
         }
-        if (mm_stats[i].valid) {
+        if (stats[i].valid) {
             if (verbose > 1)
                 printf("efficiency, ");
-            mm_stats[i].util = eval_mm_util(trace, i);
+            stats[i].util = eval_mm_util(trace, i, &stats[i]);
+            stats[i].heap = mm_stats();
+            if (heap_file && !eval_mm_restore(trace))
+                stats[i].valid = false;
             speed_params->trace = trace;
             if (verbose > 1)
                 printf("and performance.\n");
-            mm_stats[i].secs = fsec(eval_mm_speed, speed_params);
+            stats[i].secs = measure_speed(&stats[i], speed_params);
+            if (db_file)
+                eval_mm_latency(trace, &stats[i]);
         }
 
 #if 0
@@ -359,7 +501,7 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hOVlDT")) != EOF) {
+    while ((c = getopt(argc, argv, "d:f:c:s:t:v:p:k:F:H:P:r:w:a:j:B:G:n:m:hOVlDTCSMRbg")) != EOF) {
         switch (c) {
 
             case 'f': /* Use one specific trace file only (relative to curr dir) */
@@ -409,6 +551,116 @@ int main(int argc, char **argv)
                 tab_mode = true;
                 break;
 
+            case 'C':
+                compare_classes = true;
+                break;
+
+            case 'g':
+                compare_growth = true;
+                break;
+
+            case 'p':
+                parse_policies(optarg);
+                break;
+
+            case 'S':
+                print_heap_stats = true;
+                break;
+
+            case 'M':
+                mm_set_coalescing(true);
+                break;
+
+            case 'b':
+                mm_set_bibop(true);
+                break;
+
+            case 'k':
+                check_interval = atoi(optarg);
+                mm_set_checkheap_incremental(check_interval > 0);
+                break;
+
+            case 'P': {
+                char *colon = strchr(optarg, ':');
+                long threshold = atol(optarg);
+                long decay = colon ? atol(colon + 1) : PURGE_DECAY;
+                if (threshold <= 0 || decay < 0)
+                    app_error("-P takes <bytes>[:<ops>]\n");
+                mm_set_purge((size_t)threshold, (size_t)decay);
+                break;
+            }
+
+            case 'F':
+                heap_file = optarg;
+                mem_set_file(heap_file);
+                break;
+
+            case 'R':
+                measure_resident = true;
+                break;
+
+            case 'm': {
+                char *colon = strchr(optarg, ':');
+                char *end;
+                long map_op_arg;
+                if (colon != NULL) {
+                    *colon = '\0';
+                    map_prefix = colon + 1;
+                }
+                map_heap = true;
+                errno = 0;
+                map_op_arg = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || errno != 0 ||
+                    map_op_arg < -1 || map_op_arg > INT_MAX)
+                    app_error("-m takes an op number, -1 for the last op\n");
+                map_op = (int)map_op_arg;
+                break;
+            }
+
+            case 'r':
+                repetitions = atoi(optarg);
+                if (repetitions < 1 || repetitions > MAX_REPS)
+                    app_error("-r takes 1 to %d repetitions\n", MAX_REPS);
+                break;
+
+            case 'w':
+                warmups = atoi(optarg);
+                break;
+
+            case 'a': {
+                cpu_set_t set;
+                pin_cpu = atoi(optarg);
+                CPU_ZERO(&set);
+                CPU_SET(pin_cpu, &set);
+                if (sched_setaffinity(0, sizeof(set), &set) != 0)
+                    unix_error("Could not pin to CPU %d", pin_cpu);
+                break;
+            }
+
+            case 'j':
+                json_file = optarg;
+                break;
+
+            case 'B':
+                db_file = optarg;
+                break;
+
+            case 'n':
+                replay_threads = atoi(optarg);
+                if (replay_threads < 1 || replay_threads > MAX_THREADS)
+                    app_error("-n takes 1 to %d threads\n", MAX_THREADS);
+                break;
+
+            case 'G':
+                compare_spec = optarg;
+                break;
+
+            case 'H':
+                huge_pages = atoi(optarg);
+                if (huge_pages != MEM_PAGES_THP && huge_pages != MEM_PAGES_HUGETLB)
+                    app_error("-H takes 1 (transparent) or 2 (hugetlb)\n");
+                break;
+
             case 'h': /* Print this message */
                 usage(argv[0]);
                 exit(0);
@@ -418,6 +670,10 @@ int main(int argc, char **argv)
                 exit(1);
         }
     }
+
+    /* Comparing stored runs needs no traces */
+    if (compare_spec)
+        exit(compare_results(compare_spec));
 #endif /* !REF_ONLY */
 
     if (num_global_tracefiles == 0) {
@@ -430,6 +686,11 @@ int main(int argc, char **argv)
         init_random_data();
     }
 
+    /* The expensive checks also cover the driver's own statistics */
+    if (debug_mode == DBG_EXPENSIVE) {
+        check_median_ci();
+    }
+
     /* Initialize the timeout */
     if (set_timeout > 0) {
         signal(SIGALRM, timeout_handler);
@@ -491,6 +752,11 @@ int main(int argc, char **argv)
 
 #endif
 
+    if (num_policies > 0) {
+        mm_set_policy(policies[0].fit, policies[0].good_k,
+                      policies[0].addr_ordered);
+    }
+
     /*
      * Always run and evaluate the student's mm package
      */
@@ -520,9 +786,58 @@ int main(int argc, char **argv)
             printf("\nResults for mm malloc:\n");
             printresults(num_global_tracefiles, mm_stats, &global_mm_sum_stats);
             printf("\n");
+            if (print_heap_stats)
+                print_mm_stats(num_global_tracefiles, mm_stats);
+            if (measure_resident)
+                print_resident(num_global_tracefiles, mm_stats);
+            if (repetitions > 0)
+                print_stability(num_global_tracefiles, mm_stats);
         }
     }
 
+    /* Optionally save the results for later comparison */
+    if (json_file && !onetime_flag)
+        write_json(json_file, num_global_tracefiles, mm_stats);
+    if (db_file && !onetime_flag)
+        record_results(db_file, num_global_tracefiles, mm_stats);
+
+    /* Optionally replay every trace on several threads */
+    if (replay_threads > 0 && !onetime_flag) {
+        for (i = 0; i < num_global_tracefiles; i++) {
+            stats_t replay_stats;
+            mem_init();
+            trace_t *trace = read_trace(&replay_stats, tracedir,
+                                        global_tracefiles[i]);
+            replay_trace(trace, replay_threads);
+            free_trace(trace);
+            mem_deinit();
+        }
+    }
+
+    /* Optionally compare the default, tuned and adaptive size classes */
+    if (compare_classes && !onetime_flag) {
+        compare_size_classes(num_global_tracefiles, tracedir, global_tracefiles,
+                             &speed_params);
+    }
+
+    /* Optionally compare realloc with and without growth hints */
+    if (compare_growth && !onetime_flag) {
+        compare_realloc_growth(num_global_tracefiles, tracedir, global_tracefiles,
+                               &speed_params);
+    }
+
+    /* Optionally compare throughput on normal and huge pages */
+    if (huge_pages != MEM_PAGES_NORMAL && !onetime_flag) {
+        compare_page_sizes(num_global_tracefiles, tracedir, global_tracefiles,
+                           &speed_params);
+    }
+
+    /* Optionally compare several placement policies on the same traces */
+    if (num_policies > 1 && !onetime_flag) {
+        compare_policies(num_global_tracefiles, tracedir, global_tracefiles,
+                         &speed_params);
+    }
+
     /* Optionally compare the performance of mm and libc */
     if (run_libc) {
         printf("Comparison with libc malloc: mm/libc = %.0f Kops / %.0f Kops = %.2f\n", 
@@ -819,6 +1134,135 @@ static void init_random_data(void) {
     }
 }
 
+/*
+ * touch_block - write one byte in each page of a payload so it is
+ *   resident.  Huge blocks are only touched up to RESIDENT_TOUCH_MAX,
+ *   so traces that allocate more than the machine holds still run.
+ */
+static void touch_block(char *p, size_t size) {
+    size_t page = mem_pagesize();
+    size_t off;
+
+    if (size > RESIDENT_TOUCH_MAX)
+        size = RESIDENT_TOUCH_MAX;
+    for (off = 0; off < size; off += page)
+        p[off] = 0;
+    if (size > 0)
+        p[size - 1] = 0;
+}
+
+/*
+ * minor_faults - minor page faults this process has taken so far
+ */
+static long minor_faults(void) {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+/*
+ * map_cells - add size bytes at heap offset off to the cells of a map,
+ *   each cell covering span bytes
+ */
+static void map_cells(size_t (*cells)[2], size_t ncells, size_t span,
+                      size_t off, size_t size, bool allocated) {
+    while (size > 0 && off / span < ncells) {
+        size_t n = span - off % span;
+        if (n > size)
+            n = size;
+        cells[off / span][allocated ? 0 : 1] += n;
+        off += n;
+        size -= n;
+    }
+}
+
+/* map_block - mm_heap_walk callback filling in a heap_map_t */
+static void map_block(void *ptr, size_t size, bool allocated, void *ctx) {
+    heap_map_t *map = (heap_map_t *)ctx;
+    size_t off = (size_t)((char *)ptr - 8 - map->base);
+
+    map->blocks++;
+    if (allocated) {
+        map->alloc_bytes += size;
+    } else {
+        map->free_blocks++;
+        map->free_bytes += size;
+        if (size > map->largest_free)
+            map->largest_free = size;
+    }
+    map_cells(map->text, MAP_COLS * MAP_ROWS, map->cell, off, size, allocated);
+    map_cells(map->image, MAP_PIXELS * MAP_PIXELS, map->pixel, off, size,
+              allocated);
+}
+
+/*
+ * print_heap_map - walk the heap with mm_heap_walk and print a summary
+ *   and a map of it, one character per cell: '#' allocated, '.' free,
+ *   '+' both.  With a -m prefix the map is also written as a PPM image,
+ *   allocated bytes dark and free bytes light.
+ */
+static void print_heap_map(const trace_t *trace, int opnum) {
+    static heap_map_t map;
+    size_t heap_size = mem_heapsize();
+    char path[MAXLINE];
+    const char *name, *dot;
+    FILE *fp;
+    int r, c;
+
+    memset(&map, 0, sizeof(map));
+    map.base = mem_heap_lo();
+    map.cell = (heap_size + MAP_COLS * MAP_ROWS - 1) / (MAP_COLS * MAP_ROWS);
+    map.pixel = (heap_size + MAP_PIXELS * MAP_PIXELS - 1) /
+        (MAP_PIXELS * MAP_PIXELS);
+    if (map.cell == 0)
+        map.cell = map.pixel = 1;
+    mm_heap_walk(map_block, &map);
+
+    printf("Heap map of %s after op %d (%.0f KB heap, %zu bytes per cell):\n",
+           trace->filename, opnum, heap_size / 1024.0, map.cell);
+    printf("  %zu blocks, %zu free; %.0f KB allocated, %.0f KB free, "
+           "largest free %.0f KB, fragmentation %.1f%%\n",
+           map.blocks, map.free_blocks, map.alloc_bytes / 1024.0,
+           map.free_bytes / 1024.0, map.largest_free / 1024.0,
+           map.free_bytes ?
+           100.0 * (1.0 - (double)map.largest_free / map.free_bytes) : 0.0);
+    for (r = 0; r < MAP_ROWS; r++) {
+        printf("  |");
+        for (c = 0; c < MAP_COLS; c++) {
+            size_t *cell = map.text[r * MAP_COLS + c];
+            putchar(cell[0] + cell[1] == 0 ? ' ' :
+                    cell[1] == 0 ? '#' : cell[0] == 0 ? '.' : '+');
+        }
+        printf("|\n");
+    }
+    printf("\n");
+
+    if (map_prefix == NULL)
+        return;
+    /* <prefix>-<trace>.ppm, the trace file name without its directory and extension */
+    name = strrchr(trace->filename, '/');
+    name = name ? name + 1 : trace->filename;
+    dot = strrchr(name, '.');
+    snprintf(path, sizeof(path), "%s-%.*s.ppm", map_prefix,
+             dot ? (int)(dot - name) : (int)strlen(name), name);
+    if ((fp = fopen(path, "wb")) == NULL)
+        unix_error("Could not open %s in print_heap_map", path);
+    fprintf(fp, "P6\n%d %d\n255\n", MAP_PIXELS, MAP_PIXELS);
+    for (r = 0; r < MAP_PIXELS * MAP_PIXELS; r++) {
+        size_t *px = map.image[r];
+        unsigned char rgb[3] = {255, 255, 255};     /* beyond the blocks */
+        if (px[0] + px[1] > 0) {
+            double f = (double)px[0] / (px[0] + px[1]);
+            rgb[0] = (unsigned char)(230 - 190 * f);
+            rgb[1] = (unsigned char)(230 - 150 * f);
+            rgb[2] = (unsigned char)(200 - 60 * f);
+        }
+        fwrite(rgb, 1, 3, fp);
+    }
+    fclose(fp);
+}
+
 static void randomize_block(trace_t *traces, int index) {
     size_t size, fsize, fsize_end;
     size_t i;
@@ -940,6 +1384,10 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     int max_index = 0;
     int op_index;
     int ignore = 0;
+    int tid = 0, dep = -1;
+    char magic[sizeof(BIN_TRACE_MAGIC) - 1];
+    bin_header_t bin_header;
+    bool binary;
 
     if (verbose > 1)
         printf("Reading tracefile: %s\n", filename);
@@ -954,12 +1402,24 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     if ((tracefile = fopen(trace->filename, "r")) == NULL) {
         unix_error("Could not open %s in read_trace", trace->filename);
     }
-    int iweight;
-    ignore += fscanf(tracefile, "%d", &iweight);
-    trace->weight = iweight;
-    ignore += fscanf(tracefile, "%d", &trace->num_ids);
-    ignore +=  fscanf(tracefile, "%d", &trace->num_ops);
-    ignore +=  fscanf(tracefile, "%zd", &trace->data_bytes);
+    binary = fread(magic, 1, sizeof(magic), tracefile) == sizeof(magic) &&
+        memcmp(magic, BIN_TRACE_MAGIC, sizeof(magic)) == 0;
+    if (binary) {
+        if (fread(&bin_header, sizeof(bin_header), 1, tracefile) != 1)
+            app_error("%s: truncated binary trace header", trace->filename);
+        trace->weight = bin_header.weight;
+        trace->num_ids = (int)bin_header.num_ids;
+        trace->num_ops = (int)bin_header.num_ops;
+        trace->data_bytes = bin_header.data_bytes;
+    } else {
+        rewind(tracefile);
+        int iweight;
+        ignore += fscanf(tracefile, "%d", &iweight);
+        trace->weight = iweight;
+        ignore += fscanf(tracefile, "%d", &trace->num_ids);
+        ignore +=  fscanf(tracefile, "%d", &trace->num_ops);
+        ignore +=  fscanf(tracefile, "%zd", &trace->data_bytes);
+    }
 
     if (((unsigned int)trace->weight) > 3u) {
         app_error("%s: weight can only be in {0, 1, 2 3}", trace->filename);
@@ -989,8 +1449,49 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     /* read every request line in the trace file */
     index = 0;
     op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
+    trace->num_threads = 1;
+    trace->threaded = false;
+    if (binary) {
+        bin_op_t op;
+        for (; op_index < trace->num_ops; op_index++) {
+            if (fread(&op, sizeof(op), 1, tracefile) != 1)
+                app_error("%s: truncated binary trace at request %d",
+                          trace->filename, op_index);
+            if ((op.type != 'a' && op.type != 'r' && op.type != 'f') ||
+                op.index < 0 || op.index >= trace->num_ids ||
+                op.tid >= MAX_THREADS || op.dep >= op_index)
+                app_error("%s: bad binary request %d", trace->filename, op_index);
+            trace->ops[op_index].type = (op.type == 'a') ? ALLOC :
+                (op.type == 'r') ? REALLOC : FREE;
+            trace->ops[op_index].index = op.index;
+            trace->ops[op_index].size = op.size;
+            trace->ops[op_index].tid = op.tid;
+            trace->ops[op_index].dep = op.dep < 0 ? -1 : op.dep;
+            if (op.type != 'f')
+                max_index = (op.index > max_index) ? op.index : max_index;
+            if (op.tid != 0)
+                trace->threaded = true;
+            if (op.tid >= trace->num_threads)
+                trace->num_threads = op.tid + 1;
+        }
+    }
+    while (!binary && fscanf(tracefile, "%s", type) != EOF) {
         switch(type[0]) {
+            case 't': /* thread id prefix for the next request */
+                tid = atoi(type + 1);
+                if (tid < 0 || tid >= MAX_THREADS)
+                    app_error("%s: thread id %d is not in 0..%d",
+                              trace->filename, tid, MAX_THREADS - 1);
+                trace->threaded = true;
+                if (tid >= trace->num_threads)
+                    trace->num_threads = tid + 1;
+                continue;
+            case '^': /* next request waits for an earlier one */
+                dep = atoi(type + 1);
+                if (dep < 0 || dep >= op_index)
+                    app_error("%s: request %d depends on %s, not an earlier request",
+                              trace->filename, op_index, type + 1);
+                continue;
             case 'a':
                 ignore += fscanf(tracefile, "%u %lu", &index, &size);
                 trace->ops[op_index].type = ALLOC;
@@ -1014,6 +1515,10 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
                 app_error("Bogus type character (%c) in tracefile %s\n",
                           type[0], trace->filename);
         }
+        trace->ops[op_index].tid = tid;
+        trace->ops[op_index].dep = dep;
+        tid = 0;
+        dep = -1;
         op_index++;
         if (op_index == trace->num_ops) break;
     }
@@ -1101,6 +1606,12 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
                     return false;
                 r = r->next;
             }
+        } else if (check_interval > 0 && i > 0 && i % check_interval == 0) {
+            /* Check the blocks touched by the last check_interval ops */
+            if (!mm_checkheap(__LINE__)) {
+                malloc_error(trace, i, "mm_checkheap returned false\n");
+                return false;
+            }
         }
 
         switch (trace->ops[i].type) {
@@ -1190,6 +1701,11 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
                 app_error("Nonexistent request type in eval_mm_valid");
         }
     }
+    if (check_interval > 0 && !mm_checkheap(__LINE__)) {
+        malloc_error(trace, trace->num_ops - 1, "mm_checkheap returned false\n");
+        return false;
+    }
+
     /* As far as we know, this is a valid malloc package */
     return true;
 }
@@ -1205,8 +1721,19 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
  *   is always the high water mark of the heap.
  *
  *   A higher number is better: 1 is optimal.
+ *
+ *   With -R, the heap's pages are first given back to the kernel,
+ *   every payload is written one byte per page, as a program using
+ *   it would, and the pages touched since are sampled with mincore every
+ *   RESIDENT_STRIDE ops and whenever the heap grows.  Payload beyond
+ *   RESIDENT_TOUCH_MAX is counted as resident without touching it.
+ *   stats->rutil is the same high-water mark over the peak resident
+ *   bytes, so pages the allocator hands back to the kernel count in its
+ *   favour, and stats->faults the minor faults taken paging them back in,
+ *   including the driver's own payload writes.  stats->mm_faults counts
+ *   only the ones taken inside the allocator calls.
  */
-static double eval_mm_util(trace_t *trace, int tracenum)
+static double eval_mm_util(trace_t *trace, int tracenum, stats_t *stats)
 {
     int i;
     int index;
@@ -1215,17 +1742,30 @@ static double eval_mm_util(trace_t *trace, int tracenum)
     size_t total_size = 0;
     size_t max_heap_size = 0;
     size_t heap_size = 0;
+    size_t max_resident = 0;
+    size_t sum_resident = 0, samples = 0;
+    size_t untouched = 0;
+    size_t resident;
+    struct rusage usage;
+    long faults = 0, mm_faults = 0, mark = 0;
     char *p;
     char *newp, *oldp;
 
     reinit_trace(trace);
 
     /* initialize the heap and the mm malloc package */
+    if (measure_resident) {
+        mem_release();
+        getrusage(RUSAGE_SELF, &usage);
+        faults = usage.ru_minflt;
+    }
     mem_reset_brk();
     if (!mm_init())
         app_error("trace %d: mm_init failed in eval_mm_util", tracenum);
 
     for (i = 0;  i < trace->num_ops;  i++) {
+        if (measure_resident)
+            mark = minor_faults();
         switch (trace->ops[i].type) {
 
             case ALLOC: /* mm_alloc */
@@ -1236,10 +1776,16 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                     app_error("trace %d: mm_malloc failed in eval_mm_util",
                               tracenum);
                 }
+                if (measure_resident)
+                    mm_faults += minor_faults() - mark;
 
                 /* Remember region and size */
                 trace->blocks[index] = p;
                 trace->block_sizes[index] = size;
+                if (measure_resident) {
+                    touch_block(p, size);
+                    untouched += UNTOUCHED(size);
+                }
 
                 total_size += size;
                 break;
@@ -1254,10 +1800,17 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                     app_error("trace %d: mm_realloc failed in eval_mm_util",
                               tracenum);
                 }
+                if (measure_resident)
+                    mm_faults += minor_faults() - mark;
 
                 /* Remember region and size */
                 trace->blocks[index] = newp;
                 trace->block_sizes[index] = newsize;
+                if (measure_resident) {
+                    touch_block(newp, newsize);
+                    untouched += UNTOUCHED(newsize);
+                    untouched -= UNTOUCHED(oldsize);
+                }
 
                 total_size += (newsize - oldsize);
                 break;
@@ -1273,6 +1826,10 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                 }
 
                 mm_free(p);
+                if (measure_resident) {
+                    mm_faults += minor_faults() - mark;
+                    untouched -= UNTOUCHED(size);
+                }
 
                 total_size -= size;
                 break;
@@ -1286,8 +1843,31 @@ static double eval_mm_util(trace_t *trace, int tracenum)
         max_total_size = (total_size > max_total_size) ?
             total_size : max_total_size;
         heap_size = mem_heapsize();
+        if (measure_resident &&
+            (heap_size > max_heap_size || i % RESIDENT_STRIDE == 0 ||
+             i == trace->num_ops - 1)) {
+            resident = mem_resident() + untouched;
+            max_resident = (resident > max_resident) ?
+                resident : max_resident;
+            sum_resident += resident;
+            samples++;
+        }
         max_heap_size = (heap_size > max_heap_size) ?
             heap_size : max_heap_size;
+        if (map_heap && (i == map_op ||
+                         (i == trace->num_ops - 1 &&
+                          (map_op < 0 || map_op >= trace->num_ops))))
+            print_heap_map(trace, i);
+    }
+
+    if (measure_resident) {
+        getrusage(RUSAGE_SELF, &usage);
+        stats->faults = usage.ru_minflt - faults;
+        stats->mm_faults = mm_faults;
+        stats->resident = max_resident;
+        stats->avg_resident = samples ? sum_resident / samples : 0;
+        stats->rutil = max_resident ?
+            (double)max_total_size / (double)max_resident : 0.0;
     }
 
 #if !REF_ONLY
@@ -1298,6 +1878,62 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 }
 
 
+/*
+ * eval_mm_restore - Checkpoint the heap left by eval_mm_util, remap the
+ *   backing file at a different base and check that mm_restore picks it
+ *   up intact. The root handed to mm_checkpoint must come back at the
+ *   same offset from the new base.
+ */
+static bool eval_mm_restore(trace_t *trace)
+{
+    void *root = NULL;
+    void *restored;
+    void *old_base = mem_heap_lo();
+    bool ok;
+    int i;
+    struct timespec start, end;
+
+    /* Use the last block still allocated, if any, as the root */
+    for (i = trace->num_ids - 1; i >= 0 && root == NULL; i--)
+        if (trace->block_sizes[i] > 0)
+            root = trace->blocks[i];
+    long root_offset = root ? (char *)root - (char *)mem_heap_lo() : -1;
+
+    if (!mm_checkpoint(root)) {
+        malloc_error(trace, trace->num_ops - 1, "mm_checkpoint failed.");
+        return false;
+    }
+    mem_deinit();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!mem_restore(true) || !mm_restore(&restored)) {
+        malloc_error(trace, trace->num_ops - 1, "mm_restore failed.");
+        return false;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (verbose > 1)
+        printf("restored %zu byte heap in %.0f usecs, ", mem_heapsize(),
+               (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) * 1e-3);
+    if (mem_heap_lo() == old_base) {
+        malloc_error(trace, trace->num_ops - 1, "mem_restore did not move the heap.");
+        return false;
+    }
+    if ((root_offset < 0 && restored != NULL) ||
+        (root_offset >= 0 && (char *)restored - (char *)mem_heap_lo() != root_offset)) {
+        malloc_error(trace, trace->num_ops - 1, "mm_restore returned the wrong root.");
+        return false;
+    }
+    /* Nothing has been touched since mm_restore, so an incremental
+       check would pass without looking at the heap */
+    mm_set_checkheap_incremental(false);
+    ok = mm_checkheap(__LINE__);
+    mm_set_checkheap_incremental(check_interval > 0);
+    if (!ok) {
+        malloc_error(trace, trace->num_ops - 1, "mm_checkheap failed after mm_restore.");
+        return false;
+    }
+    return true;
+}
+
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
  *    to measure the running time of the mm malloc package.
@@ -1351,6 +1987,211 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_latency - Replay the trace once more, timing each request on
+ *    its own, and keep the 50th, 90th and 99th percentile latencies.
+ */
+static void eval_mm_latency(trace_t *trace, stats_t *stats)
+{
+    int i, index;
+    char *p;
+    struct timespec start, end;
+    double *ns = malloc(trace->num_ops * sizeof(double));
+
+    if (ns == NULL)
+        unix_error("latency malloc in eval_mm_latency failed");
+    reinit_trace(trace);
+    mem_reset_brk();
+    if (!mm_init())
+        app_error("mm_init failed in eval_mm_latency");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+        index = trace->ops[i].index;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        switch (trace->ops[i].type) {
+            case ALLOC:
+                p = mm_malloc(trace->ops[i].size);
+                trace->blocks[index] = p;
+                break;
+            case REALLOC:
+                p = mm_realloc(trace->blocks[index], trace->ops[i].size);
+                trace->blocks[index] = p;
+                break;
+            case FREE:
+                mm_free(index < 0 ? NULL : trace->blocks[index]);
+                break;
+            default:
+                app_error("Nonexistent request type in eval_mm_latency");
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ns[i] = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    }
+
+    if (trace->num_ops > 0) {
+        qsort(ns, trace->num_ops, sizeof(double), cmp_double);
+        stats->lat_p50 = ns[(int)(0.50 * (trace->num_ops - 1))];
+        stats->lat_p90 = ns[(int)(0.90 * (trace->num_ops - 1))];
+        stats->lat_p99 = ns[(int)(0.99 * (trace->num_ops - 1))];
+    }
+    free(ns);
+}
+
+/*
+ * Multi-threaded replay (-n).  Each request runs on thread
+ * tid % nthreads, or for traces without thread ids on id % nthreads,
+ * in trace order.  A request first waits for the previous request on
+ * the same block and for its '^' dependency; every such request comes
+ * earlier in the trace, so the replay cannot deadlock.  mm.c keeps
+ * global state, so the allocator calls themselves are serialized by
+ * mm_lock, and a request's latency includes the time spent waiting for it.
+ */
+static pthread_mutex_t mm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    trace_t *trace;
+    int *prev;            /* previous request on the same block, or -1 */
+    char *done;           /* set once each request has run */
+} replay_t;
+
+typedef struct {
+    replay_t *replay;
+    int *ops;             /* this thread's requests, in trace order */
+    int num_ops;
+    double *ns;           /* latency of each of them */
+} replay_thread_t;
+
+/* the thread a request is replayed on */
+static int replay_owner(const trace_t *trace, const traceop_t *op, int nthreads)
+{
+    if (trace->threaded)
+        return op->tid % nthreads;
+    return (op->index < 0 ? 0 : (int)op->index) % nthreads;
+}
+
+/* wait until request i of the replay has run, if i names one */
+static void replay_wait(replay_t *replay, int i)
+{
+    while (i >= 0 && !__atomic_load_n(&replay->done[i], __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+static void *replay_thread(void *arg)
+{
+    replay_thread_t *t = arg;
+    replay_t *replay = t->replay;
+    trace_t *trace = replay->trace;
+    struct timespec start, end;
+    int k;
+
+    for (k = 0; k < t->num_ops; k++) {
+        int i = t->ops[k];
+        traceop_t *op = &trace->ops[i];
+
+        replay_wait(replay, replay->prev[i]);
+        replay_wait(replay, op->dep);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_mutex_lock(&mm_lock);
+        switch (op->type) {
+            case ALLOC:
+                trace->blocks[op->index] = mm_malloc(op->size);
+                if (trace->blocks[op->index] == NULL)
+                    app_error("mm_malloc error in replay_thread");
+                break;
+            case REALLOC:
+                trace->blocks[op->index] =
+                    mm_realloc(trace->blocks[op->index], op->size);
+                if (trace->blocks[op->index] == NULL && op->size != 0)
+                    app_error("mm_realloc error in replay_thread");
+                break;
+            case FREE:
+                mm_free(op->index < 0 ? NULL : trace->blocks[op->index]);
+                break;
+        }
+        pthread_mutex_unlock(&mm_lock);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        t->ns[k] = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+        __atomic_store_n(&replay->done[i], 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/*
+ * replay_trace - replay a trace on nthreads threads and print the
+ *     aggregate throughput and each thread's latency percentiles
+ */
+static void replay_trace(trace_t *trace, int nthreads)
+{
+    replay_t replay;
+    replay_thread_t threads[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    int *last = calloc(trace->num_ids, sizeof(int));
+    struct timespec start, end;
+    int i, t, cross = 0;
+    double secs;
+
+    replay.trace = trace;
+    replay.prev = malloc(trace->num_ops * sizeof(int));
+    replay.done = calloc(trace->num_ops, 1);
+    if (last == NULL || replay.prev == NULL || replay.done == NULL)
+        unix_error("malloc failed in replay_trace");
+    for (t = 0; t < nthreads; t++) {
+        threads[t].replay = &replay;
+        threads[t].num_ops = 0;
+        threads[t].ops = malloc(trace->num_ops * sizeof(int));
+        threads[t].ns = malloc(trace->num_ops * sizeof(double));
+        if (threads[t].ops == NULL || threads[t].ns == NULL)
+            unix_error("malloc failed in replay_trace");
+    }
+
+    /* last[id] is 1 + the last request on block id so far */
+    for (i = 0; i < trace->num_ops; i++) {
+        traceop_t *op = &trace->ops[i];
+        t = replay_owner(trace, op, nthreads);
+        threads[t].ops[threads[t].num_ops++] = i;
+        replay.prev[i] = (op->index < 0) ? -1 : last[op->index] - 1;
+        if (replay.prev[i] >= 0 &&
+            replay_owner(trace, &trace->ops[replay.prev[i]], nthreads) != t)
+            cross++;
+        if (op->index >= 0)
+            last[op->index] = i + 1;
+    }
+
+    reinit_trace(trace);
+    mem_reset_brk();
+    if (!mm_init())
+        app_error("mm_init failed in replay_trace");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (t = 0; t < nthreads; t++)
+        if (pthread_create(&ids[t], NULL, replay_thread, &threads[t]) != 0)
+            unix_error("pthread_create failed in replay_trace");
+    for (t = 0; t < nthreads; t++)
+        pthread_join(ids[t], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    printf("Replay of %s on %d threads: %.0f Kops, %d cross-thread requests%s\n",
+           trace->filename, nthreads, trace->num_ops * 1e-3 / secs, cross,
+           mm_checkheap(__LINE__) ? "" : ", HEAP CHECK FAILED");
+    printf("%8s%10s%10s%10s%10s\n", "thread", "ops", "p50 ns", "p90 ns", "p99 ns");
+    for (t = 0; t < nthreads; t++) {
+        int n = threads[t].num_ops;
+        if (n > 0) {
+            qsort(threads[t].ns, n, sizeof(double), cmp_double);
+            printf("%8d%10d%10.0f%10.0f%10.0f\n", t, n,
+                   threads[t].ns[(int)(0.50 * (n - 1))],
+                   threads[t].ns[(int)(0.90 * (n - 1))],
+                   threads[t].ns[(int)(0.99 * (n - 1))]);
+        }
+        free(threads[t].ops);
+        free(threads[t].ns);
+    }
+    printf("\n");
+    free(last);
+    free(replay.prev);
+    free(replay.done);
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -1620,6 +2461,605 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
     }
 }
 
+/*
+ * print_comparison - print util and throughput of the same traces run
+ *     under several allocator configurations, one column per config.
+ */
+static void print_comparison(int n, const char *title, const char **names,
+                             stats_t **stats, int nconfigs)
+{
+    int i, m;
+
+    printf("\n%s (util / Kops):\n", title);
+    for (m = 0; m < nconfigs; m++)
+        printf("%18s", names[m]);
+    printf("  trace\n");
+    for (i = 0; i < n; i++) {
+        for (m = 0; m < nconfigs; m++) {
+            if (stats[m][i].valid && stats[m][i].secs > 0)
+                printf("  %6.1f%% %8.0f", stats[m][i].util * 100.0,
+                       (stats[m][i].ops * 1e-3) / stats[m][i].secs);
+            else
+                printf("  %6s  %8s", "-", "-");
+        }
+        printf("  %s\n", stats[0][i].filename);
+    }
+}
+
+/*
+ * print_mm_stats - print the allocator's own counters for each trace,
+ *     taken at the end of its utilization run.
+ */
+static void print_mm_stats(int n, stats_t *stats)
+{
+    int i, l;
+
+    printf("Allocator statistics at end of trace (sizes in KB):\n");
+    printf("%8s%12s%8s%8s%8s%10s%8s%12s%6s  %s\n",
+           "extends", "sbrk", "splits", "coal", "search", "alloc",
+           "blocks", "free", "runs", "free by list");
+    for (i = 0; i < n; i++) {
+        mm_stats_t *h = &stats[i].heap;
+        size_t free_bytes = 0;
+
+        if (!stats[i].valid) {
+            printf("%8s%12s%8s%8s%8s%10s%8s%12s%6s  %s\n",
+                   "-", "-", "-", "-", "-", "-", "-", "-", "-", stats[i].filename);
+            continue;
+        }
+        for (l = 0; l < MM_NUM_LISTS; l++)
+            free_bytes += h->free_bytes[l];
+        printf("%8zu%12.0f%8zu%8zu%8.1f%10.0f%8zu%12.0f%6zu  ",
+               h->extend_calls, h->sbrk_bytes / 1024.0, h->splits,
+               h->coalesces,
+               h->searches ? (double)h->search_steps / h->searches : 0.0,
+               h->alloc_bytes / 1024.0, h->alloc_blocks, free_bytes / 1024.0,
+               h->small_runs);
+        for (l = 0; l < MM_NUM_LISTS; l++)
+            printf("%s%.0f", l ? "/" : "", h->free_bytes[l] / 1024.0);
+        printf("  %s\n", stats[i].filename);
+    }
+    printf("\n");
+}
+
+/* qsort comparison for doubles */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * median_ci - indexes into n sorted samples of a 95% confidence interval
+ *     of the median.  The 1-based ranks floor(n/2 - 0.98 sqrt(n)) and
+ *     ceil(n/2 + 1 + 0.98 sqrt(n)) bracket it (Le Boudec, Performance
+ *     Evaluation, Thm 2.1); they are clamped to 1..n and made 0-based.
+ */
+static void median_ci(int n, int *lo, int *hi)
+{
+    double h = 0.98 * sqrt((double)n);
+    int j = (int)floor(n / 2.0 - h);
+    int k = (int)ceil(n / 2.0 + 1 + h);
+
+    *lo = (j < 1 ? 1 : j) - 1;
+    *hi = (k > n ? n : k) - 1;
+}
+
+/*
+ * check_median_ci - check median_ci against ranks worked out by hand
+ */
+static void check_median_ci(void)
+{
+    static const int cases[][3] = {
+        /* n, lo, hi */
+        {1, 0, 0}, {2, 0, 1}, {10, 0, 9}, {20, 4, 15}, {100, 39, 60},
+    };
+    size_t i;
+    int lo, hi;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        median_ci(cases[i][0], &lo, &hi);
+        if (lo != cases[i][1] || hi != cases[i][2])
+            app_error("median_ci(%d) gave [%d, %d], expected [%d, %d]\n",
+                      cases[i][0], lo, hi, cases[i][1], cases[i][2]);
+    }
+}
+
+/*
+ * measure_speed - time eval_mm_speed on a trace and return the seconds
+ *     it takes.  In stability mode (-r) the trace is first run untimed
+ *     warmups times, then timed repetitions times; the median is
+ *     returned and the samples and a 95% confidence interval of the
+ *     median are kept in stats.  The interval comes from the order
+ *     statistics, so it makes no assumption about the distribution.
+ */
+static double measure_speed(stats_t *stats, speed_t *speed_params)
+{
+    double sorted[MAX_REPS];
+    double med;
+    int r, n, lo, hi;
+
+    if (repetitions == 0)
+        return fsec(eval_mm_speed, speed_params);
+
+    for (r = 0; r < warmups; r++)
+        eval_mm_speed(speed_params);
+    for (r = 0; r < repetitions; r++)
+        stats->kops[r] = stats->ops * 1e-3 / fsec(eval_mm_speed, speed_params);
+    n = stats->reps = repetitions;
+
+    memcpy(sorted, stats->kops, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), cmp_double);
+    med = (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+
+    median_ci(n, &lo, &hi);
+    stats->kops_lo = sorted[lo];
+    stats->kops_hi = sorted[hi];
+
+    return stats->ops * 1e-3 / med;
+}
+
+/*
+ * print_stability - print the median throughput of each trace with
+ *     its 95% confidence interval and relative width
+ */
+static void print_stability(int n, stats_t *stats)
+{
+    int i;
+
+    printf("Throughput over %d repetitions, %d warm-up%s%s:\n",
+           repetitions, warmups, warmups == 1 ? "" : "s",
+           pin_cpu >= 0 ? ", pinned" : "");
+    printf("%10s%10s%10s%8s  %s\n", "median", "ci lo", "ci hi", "+-", "trace");
+    for (i = 0; i < n; i++) {
+        double kops;
+        if (!stats[i].valid) {
+            printf("%10s%10s%10s%8s  %s\n", "-", "-", "-", "-", stats[i].filename);
+            continue;
+        }
+        kops = stats[i].ops * 1e-3 / stats[i].secs;
+        printf("%10.0f%10.0f%10.0f%7.1f%%  %s\n",
+               kops, stats[i].kops_lo, stats[i].kops_hi,
+               50.0 * (stats[i].kops_hi - stats[i].kops_lo) / kops,
+               stats[i].filename);
+    }
+    printf("\n");
+}
+
+/* print s as a JSON string */
+static void json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+/*
+ * write_json - write the per-trace results of the mm run to path
+ */
+static void write_json(const char *path, int n, stats_t *stats)
+{
+    FILE *f = fopen(path, "w");
+    int i, r;
+
+    if (f == NULL)
+        unix_error("Could not open JSON file '%s'", path);
+    fprintf(f, "{\n  \"repetitions\": %d,\n  \"warmups\": %d,\n  \"cpu\": %d,\n",
+            repetitions, repetitions ? warmups : 0, pin_cpu);
+    fprintf(f, "  \"traces\": [\n");
+    for (i = 0; i < n; i++) {
+        fprintf(f, "    {\"trace\": ");
+        json_string(f, stats[i].filename);
+        fprintf(f, ", \"valid\": %s", stats[i].valid ? "true" : "false");
+        if (stats[i].valid) {
+            fprintf(f, ", \"util\": %.4f, \"ops\": %.0f, \"kops\": %.1f",
+                    stats[i].util, stats[i].ops,
+                    stats[i].ops * 1e-3 / stats[i].secs);
+            if (stats[i].reps > 0) {
+                fprintf(f, ", \"ci95\": [%.1f, %.1f], \"samples\": [",
+                        stats[i].kops_lo, stats[i].kops_hi);
+                for (r = 0; r < stats[i].reps; r++)
+                    fprintf(f, "%s%.1f", r ? ", " : "", stats[i].kops[r]);
+                fprintf(f, "]");
+            }
+        }
+        fprintf(f, "}%s\n", i < n - 1 ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+}
+
+/*
+ * Results file (-B, -G).  One tab-separated line per trace and run:
+ *   run commit cpu trace util kops kops_lo kops_hi p50 p90 p99
+ * Kops bounds are the -r confidence interval, or kops without -r, and
+ * latencies are in ns.
+ */
+#define DB_HEADER "# run\tcommit\tcpu\ttrace\tutil\tkops\tkops_lo\tkops_hi" \
+                  "\tp50_ns\tp90_ns\tp99_ns\n"
+
+typedef struct {
+    char run[32];
+    char commit[64];
+    char cpu[128];
+    char trace[256];
+    double util, kops, kops_lo, kops_hi, p50, p90, p99;
+} result_t;
+
+/* Short hash of the checked out commit, with '+' if the tree is dirty */
+static void get_commit(char *commit, size_t len)
+{
+    FILE *p = popen("git rev-parse --short HEAD 2>/dev/null", "r");
+    snprintf(commit, len, "unknown");
+    if (p == NULL)
+        return;
+    if (fgets(commit, (int)len, p) == NULL)
+        snprintf(commit, len, "unknown");
+    commit[strcspn(commit, "\n")] = '\0';
+    if (pclose(p) == 0 &&
+        system("git diff --quiet HEAD -- . 2>/dev/null") != 0 &&
+        strlen(commit) + 1 < len)
+        strcat(commit, "+");
+}
+
+/*
+ * record_results - append the valid traces of this run to path.  The
+ *     run id is the start time plus the pid, so runs recorded in the
+ *     same second stay apart.
+ */
+static void record_results(const char *path, int n, stats_t *stats)
+{
+    char run[32], commit[64], cpu[MAXLINE] = "unknown";
+    time_t now = time(NULL);
+    FILE *f;
+    int i;
+
+    strftime(run, sizeof(run), "%Y%m%d-%H%M%S", localtime(&now));
+    snprintf(run + strlen(run), sizeof(run) - strlen(run), "-%d", (int)getpid());
+    get_commit(commit, sizeof(commit));
+    get_cpu_type(cpu);
+    if ((f = fopen(path, "a")) == NULL)
+        unix_error("Could not open results file '%s'", path);
+    if (ftell(f) == 0)
+        fputs(DB_HEADER, f);
+    for (i = 0; i < n; i++) {
+        double kops;
+        if (!stats[i].valid)
+            continue;
+        kops = stats[i].ops * 1e-3 / stats[i].secs;
+        fprintf(f, "%s\t%s\t%s\t%s\t%.4f\t%.1f\t%.1f\t%.1f\t%.0f\t%.0f\t%.0f\n",
+                run, commit, cpu, stats[i].filename, stats[i].util, kops,
+                stats[i].reps ? stats[i].kops_lo : kops,
+                stats[i].reps ? stats[i].kops_hi : kops,
+                stats[i].lat_p50, stats[i].lat_p90, stats[i].lat_p99);
+    }
+    fclose(f);
+    printf("Recorded run %s (commit %s) in %s\n", run, commit, path);
+}
+
+/* Read every record in path; returns how many, *out is malloc'ed */
+static int load_results(const char *path, result_t **out)
+{
+    char buf[2 * MAXLINE];
+    result_t *rs = NULL;
+    int n = 0, cap = 0;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL)
+        unix_error("Could not open results file '%s'", path);
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        result_t r;
+        if (buf[0] == '#')
+            continue;
+        if (sscanf(buf, "%31[^\t]\t%63[^\t]\t%127[^\t]\t%255[^\t]\t%lf\t%lf\t%lf\t%lf\t%lf\t%lf\t%lf",
+                   r.run, r.commit, r.cpu, r.trace, &r.util, &r.kops,
+                   &r.kops_lo, &r.kops_hi, &r.p50, &r.p90, &r.p99) != 11)
+            continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 256;
+            if ((rs = realloc(rs, cap * sizeof(result_t))) == NULL)
+                unix_error("realloc in load_results failed");
+        }
+        rs[n++] = r;
+    }
+    fclose(f);
+    *out = rs;
+    return n;
+}
+
+/*
+ * find_run - the last run other than skip whose id or commit starts
+ *     with key, or any run if key is NULL.  Returns an index into rs.
+ */
+static int find_run(result_t *rs, int n, const char *key, const char *skip)
+{
+    int i;
+    for (i = n - 1; i >= 0; i--) {
+        if (skip && strcmp(rs[i].run, skip) == 0)
+            continue;
+        if (key == NULL ||
+            strncmp(rs[i].run, key, strlen(key)) == 0 ||
+            strncmp(rs[i].commit, key, strlen(key)) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * compare_results - compare two runs in a results file, given as
+ *     <db>[:<a>[,<b>]] with a and b run ids or commit prefixes.  The
+ *     noise allowed on a trace's throughput is the widest of the two
+ *     runs' confidence intervals, the spread of every run of the base
+ *     commit on the same CPU, and NOISE_FLOOR.  Returns 1 if any trace
+ *     regressed by more than that, else 0.
+ */
+static int compare_results(char *spec)
+{
+    char *path = spec, *keys = strchr(spec, ':'), *key_b = NULL;
+    result_t *rs;
+    int n, a, b, i, j, regressions = 0;
+
+    if (keys) {
+        *keys++ = '\0';
+        if ((key_b = strchr(keys, ',')) != NULL)
+            *key_b++ = '\0';
+    }
+    n = load_results(path, &rs);
+    b = find_run(rs, n, key_b, NULL);
+    if (b < 0)
+        app_error("No run '%s' in %s\n", key_b ? key_b : "", path);
+    /* never the new run itself, even when it matches the base's key */
+    a = find_run(rs, n, keys, rs[b].run);
+    if (a < 0)
+        app_error("No run to compare with in %s\n", path);
+
+    printf("Comparing run %s (%s) with run %s (%s)\n",
+           rs[b].run, rs[b].commit, rs[a].run, rs[a].commit);
+    if (strcmp(rs[a].cpu, rs[b].cpu) != 0)
+        printf("Warning: runs are on different CPUs (%s, %s)\n", rs[a].cpu, rs[b].cpu);
+    printf("%10s%10s%9s%8s%9s%9s  %-10s %s\n", "base Kops", "new Kops", "change",
+           "noise", "util", "p99 ns", "", "trace");
+
+    for (i = 0; i < n; i++) {
+        const result_t *nw = &rs[i], *base = NULL;
+        double lo = 0, hi = 0, noise, change;
+        const char *verdict = "";
+
+        if (strcmp(nw->run, rs[b].run) != 0)
+            continue;
+        for (j = 0; j < n; j++) {
+            const result_t *r = &rs[j];
+            if (strcmp(r->trace, nw->trace) != 0)
+                continue;
+            if (strcmp(r->run, rs[a].run) == 0)
+                base = r;
+            /* spread of repeated runs of the base commit */
+            if (strcmp(r->commit, rs[a].commit) == 0 &&
+                strcmp(r->cpu, rs[a].cpu) == 0) {
+                lo = (lo == 0 || r->kops < lo) ? r->kops : lo;
+                hi = (r->kops > hi) ? r->kops : hi;
+            }
+        }
+        if (base == NULL || base->kops <= 0)
+            continue;
+
+        noise = NOISE_FLOOR;
+        if ((hi - lo) / 2 / base->kops > noise)
+            noise = (hi - lo) / 2 / base->kops;
+        if ((base->kops_hi - base->kops_lo) / 2 / base->kops > noise)
+            noise = (base->kops_hi - base->kops_lo) / 2 / base->kops;
+        if ((nw->kops_hi - nw->kops_lo) / 2 / nw->kops > noise)
+            noise = (nw->kops_hi - nw->kops_lo) / 2 / nw->kops;
+        change = (nw->kops - base->kops) / base->kops;
+
+        if (change < -noise || nw->util < base->util - UTIL_NOISE) {
+            verdict = "REGRESSED";
+            regressions++;
+        } else if (change > noise || nw->util > base->util + UTIL_NOISE) {
+            verdict = "improved";
+        }
+        printf("%10.0f%10.0f%+8.1f%%%7.1f%%%+8.1f%%%9.0f  %-10s %s\n",
+               base->kops, nw->kops, change * 100.0, noise * 100.0,
+               (nw->util - base->util) * 100.0, nw->p99, verdict, nw->trace);
+    }
+    printf("%d trace%s regressed\n", regressions, regressions == 1 ? "" : "s");
+    free(rs);
+    return regressions ? 1 : 0;
+}
+
+/*
+ * print_resident - print logical and resident utilization per trace.
+ *     faults counts every minor fault of the run, in mm only the ones
+ *     taken inside the allocator calls.
+ */
+static void print_resident(int n, stats_t *stats)
+{
+    int i;
+
+    printf("Resident memory (sizes in KB):\n");
+    printf("%8s%8s%12s%12s%12s%10s%10s%12s  %s\n", "util", "rutil", "heap",
+           "peak res", "mean res", "faults", "in mm", "purged", "trace");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid) {
+            printf("%8s%8s%12s%12s%12s%10s%10s%12s  %s\n",
+                   "-", "-", "-", "-", "-", "-", "-", "-", stats[i].filename);
+            continue;
+        }
+        printf("%7.1f%%%7.1f%%%12.0f%12.0f%12.0f%10ld%10ld%12.0f  %s\n",
+               stats[i].util * 100.0, stats[i].rutil * 100.0,
+               stats[i].heap.sbrk_bytes / 1024.0,
+               stats[i].resident / 1024.0, stats[i].avg_resident / 1024.0,
+               stats[i].faults, stats[i].mm_faults,
+               stats[i].heap.purged_bytes / 1024.0, stats[i].filename);
+    }
+    printf("\n");
+}
+
+/*
+ * compare_size_classes - rerun every trace under each of mm.c's
+ *     size-class tables and print util and throughput side by side.
+ */
+static void compare_size_classes(int n, const char *tracedir, char **tracefiles,
+                                 speed_t *speed_params)
+{
+    static const char *names[] = {"default", "tuned", "adaptive"};
+    static const int modes[] = {MM_CLASSES_DEFAULT, MM_CLASSES_TUNED,
+                                MM_CLASSES_ADAPTIVE};
+    stats_t *stats[sizeof(modes) / sizeof(modes[0])];
+    const int nmodes = sizeof(modes) / sizeof(modes[0]);
+    int m;
+
+    for (m = 0; m < nmodes; m++) {
+        if ((stats[m] = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+            unix_error("stats calloc in compare_size_classes failed");
+        mm_set_size_classes(modes[m]);
+        run_tests(n, tracedir, tracefiles, stats[m], speed_params);
+    }
+    mm_set_size_classes(MM_CLASSES_DEFAULT);
+
+    print_comparison(n, "Size-class comparison", names, stats, nmodes);
+    for (m = 0; m < nmodes; m++)
+        free(stats[m]);
+}
+
+/*
+ * compare_page_sizes - rerun every trace with the heap on normal pages
+ *     and on the huge pages selected by -H, and print util and
+ *     throughput side by side.  The huge page column is named after
+ *     the pages the heap actually got, as hugetlb falls back to THP.
+ */
+static void compare_page_sizes(int n, const char *tracedir, char **tracefiles,
+                               speed_t *speed_params)
+{
+    const char *names[] = {"normal pages", "THP"};
+    const int modes[] = {MEM_PAGES_NORMAL, huge_pages};
+    stats_t *stats[2];
+    int m;
+
+    for (m = 0; m < 2; m++) {
+        if ((stats[m] = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+            unix_error("stats calloc in compare_page_sizes failed");
+        mem_set_pages(modes[m]);
+        run_tests(n, tracedir, tracefiles, stats[m], speed_params);
+    }
+    if (mem_pages() == MEM_PAGES_HUGETLB)
+        names[1] = "hugetlb";
+    mem_set_pages(MEM_PAGES_NORMAL);
+
+    print_comparison(n, "Page size comparison", names, stats, 2);
+    for (m = 0; m < 2; m++)
+        free(stats[m]);
+}
+
+/*
+ * compare_realloc_growth - rerun every trace with and without realloc
+ *     growth hints and print util, throughput and the copies realloc
+ *     made side by side.
+ */
+static void compare_realloc_growth(int n, const char *tracedir, char **tracefiles,
+                                   speed_t *speed_params)
+{
+    const char *names[] = {"copy", "geometric"};
+    stats_t *stats[2];
+    int i, m;
+
+    for (m = 0; m < 2; m++) {
+        if ((stats[m] = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+            unix_error("stats calloc in compare_realloc_growth failed");
+        mm_set_realloc_growth(m == 1);
+        run_tests(n, tracedir, tracefiles, stats[m], speed_params);
+    }
+    mm_set_realloc_growth(false);
+
+    print_comparison(n, "Realloc growth comparison", names, stats, 2);
+    printf("\nRealloc copies (copied sizes in KB):\n");
+    printf("%10s%12s%10s%12s  %s\n", "copies", "copied", "copies", "copied",
+           "trace");
+    for (i = 0; i < n; i++) {
+        for (m = 0; m < 2; m++) {
+            if (stats[m][i].valid)
+                printf("%10zu%12.0f", stats[m][i].heap.realloc_copies,
+                       stats[m][i].heap.realloc_copy_bytes / 1024.0);
+            else
+                printf("%10s%12s", "-", "-");
+        }
+        printf("  %s\n", stats[0][i].filename);
+    }
+    for (m = 0; m < 2; m++)
+        free(stats[m]);
+}
+
+/*
+ * parse_policies - parse the -p list, e.g. "first,next+ao,best,good:4".
+ *     A "+ao" suffix keeps the free lists in address order.
+ */
+static void parse_policies(char *arg)
+{
+    char *tok;
+
+    for (tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        policy_t *p;
+        char *suffix;
+
+        if (num_policies == MAX_POLICIES)
+            app_error("at most %d placement policies can be given\n", MAX_POLICIES);
+        p = &policies[num_policies++];
+        snprintf(p->name, sizeof(p->name), "%s", tok);
+        p->good_k = GOOD_FIT_K;
+        p->addr_ordered = false;
+        if ((suffix = strstr(tok, "+ao")) != NULL && suffix[3] == '\0') {
+            p->addr_ordered = true;
+            *suffix = '\0';
+        }
+        if (strcmp(tok, "first") == 0) {
+            p->fit = MM_FIT_FIRST;
+        } else if (strcmp(tok, "next") == 0) {
+            p->fit = MM_FIT_NEXT;
+        } else if (strcmp(tok, "best") == 0) {
+            p->fit = MM_FIT_BEST;
+        } else if (strcmp(tok, "good") == 0) {
+            p->fit = MM_FIT_GOOD;
+        } else if (strncmp(tok, "good:", 5) == 0 && atoi(tok + 5) > 0) {
+            p->fit = MM_FIT_GOOD;
+            p->good_k = atoi(tok + 5);
+        } else {
+            app_error("Unknown placement policy '%s'\n", p->name);
+        }
+    }
+}
+
+/*
+ * compare_policies - rerun every trace under each -p placement policy
+ *     and print util and throughput side by side.
+ */
+static void compare_policies(int n, const char *tracedir, char **tracefiles,
+                             speed_t *speed_params)
+{
+    const char *names[MAX_POLICIES];
+    stats_t *stats[MAX_POLICIES];
+    int m;
+
+    for (m = 0; m < num_policies; m++) {
+        if ((stats[m] = (stats_t *)calloc(n, sizeof(stats_t))) == NULL)
+            unix_error("stats calloc in compare_policies failed");
+        names[m] = policies[m].name;
+        mm_set_policy(policies[m].fit, policies[m].good_k,
+                      policies[m].addr_ordered);
+        run_tests(n, tracedir, tracefiles, stats[m], speed_params);
+    }
+    mm_set_policy(policies[0].fit, policies[0].good_k,
+                  policies[0].addr_ordered);
+
+    print_comparison(n, "Placement policy comparison", names, stats,
+                     num_policies);
+    for (m = 0; m < num_policies; m++)
+        free(stats[m]);
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1708,19 +3148,16 @@ static int cparse(char *s, char **index) {
     return found;
 }
 
-/* Read throughput from file */
-static double lookup_ref_throughput() {
+/* Find the CPU type in CPU_FILE, with whitespace removed */
+static bool get_cpu_type(char *cpu_type) {
     char buf[MAXLINE];
     char *tokens[PLIMIT];
-    char cpu_type[MAXLINE] = "";
-    double tput = 0.0;
-    char *bench_type = BENCH_KEY;
 
     /* Scan file to find CPU type */
     FILE *ifile = fopen(CPU_FILE, "r");
     if (!ifile) {
         fprintf(stderr, "Warning: Could not find file '%s'\n", CPU_FILE);
-        return tput;
+        return false;
     }
     /* Read lines in file.  Parse each one to look for key */
     bool found = false;
@@ -1735,17 +3172,27 @@ static double lookup_ref_throughput() {
         }
     }
     fclose(ifile);
-    if (!found) {
+    if (!found)
         fprintf(stderr, "Warning: Could not find CPU type in file '%s'\n", CPU_FILE);
+    return found;
+}
+
+/* Read throughput from file */
+static double lookup_ref_throughput() {
+    char buf[MAXLINE];
+    char *tokens[PLIMIT];
+    char cpu_type[MAXLINE] = "";
+    double tput = 0.0;
+    char *bench_type = BENCH_KEY;
+
+    if (!get_cpu_type(cpu_type))
         return tput;
-    }
     /* Now try to find matching entry in throughput file */
     FILE *tfile = fopen(THROUGHPUT_FILE, "r");
     if (tfile == NULL) {
         fprintf(stderr, "Warning: Could not open throughput file '%s'\n", THROUGHPUT_FILE);
         return tput;
     }
-    found = false;
     while (fgets(buf, MAXLINE, tfile) != NULL) {
         int t = cparse(buf, tokens);
         if (t < 3)
@@ -1753,7 +3200,6 @@ static double lookup_ref_throughput() {
         if (strcmp(tokens[0], cpu_type) == 0 &&
             strcmp(tokens[1], bench_type) == 0) {
             tput = atof(tokens[2]);
-            found = true;
             break;
         }
     }
@@ -1831,7 +3277,9 @@ static double measure_ref_throughput() {
  */
 static void usage(char *prog)
 {
-    fprintf(stderr, "Usage: %s [-hlVdD] [-f <file>]\n", prog);
+    fprintf(stderr, "Usage: %s [-hlVdDCSMRbg] [-p <list>] [-k <K>] [-F <file>] [-H <i>] [-P <b>[:<n>]]\n"
+            "\t[-r <n>] [-w <n>] [-a <cpu>] [-j <file>] [-B <db>] [-G <db>[:<a>[,<b>]]]\n"
+            "\t[-n <threads>] [-m <op>[:<prefix>]] [-f <file>]\n", prog);
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots.\n");
     fprintf(stderr, "\t-D         Equivalent to -d2.\n");
@@ -1843,5 +3291,24 @@ static void usage(char *prog)
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
     fprintf(stderr, "\t-T         Print diagnostics in tab mode\n");
+    fprintf(stderr, "\t-C         Compare default, tuned and adaptive size classes\n");
+    fprintf(stderr, "\t-g         Compare realloc with and without geometric growth hints\n");
+    fprintf(stderr, "\t-p <list>  Placement policies, e.g. first,next,best,good:8,first+ao\n");
+    fprintf(stderr, "\t-S         Print allocator statistics (mm_stats) per trace\n");
+    fprintf(stderr, "\t-M         Coalesce adjacent free blocks\n");
+    fprintf(stderr, "\t-b         Serve requests up to 128 bytes from BIBOP size-class runs\n");
+    fprintf(stderr, "\t-R         Report resident heap pages and resident utilization\n");
+    fprintf(stderr, "\t-m <op>[:<prefix>] Map the heap after op <op> (-1: last), image to <prefix>-<trace>.ppm\n");
+    fprintf(stderr, "\t-k <K>     Check the blocks touched by each K ops with mm_checkheap\n");
+    fprintf(stderr, "\t-F <file>  Back the heap with <file> and test checkpoint/restore\n");
+    fprintf(stderr, "\t-H <i>     Compare normal pages with 1: transparent huge pages, 2: hugetlb\n");
+    fprintf(stderr, "\t-P <b>[:<n>] Release pages of free blocks >= b bytes idle for n malloc/free calls, 0 on free\n");
+    fprintf(stderr, "\t-r <n>     Time each trace n times; report the median and its 95%% CI\n");
+    fprintf(stderr, "\t-w <n>     Untimed warm-up runs per trace before -r (default 2)\n");
+    fprintf(stderr, "\t-a <cpu>   Pin the driver to CPU <cpu>\n");
+    fprintf(stderr, "\t-j <file>  Write per-trace results as JSON to <file>\n");
+    fprintf(stderr, "\t-B <db>    Append util, Kops and latency percentiles to results file <db>\n");
+    fprintf(stderr, "\t-G <db>[:<a>[,<b>]]  Compare run b with run a in <db> (default: last two)\n");
+    fprintf(stderr, "\t-n <n>     Replay each trace on n threads, honouring its thread ids\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file\n");
 }
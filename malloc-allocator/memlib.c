@@ -14,6 +14,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <sys/stat.h>
 
 #include "memlib.h"
 #include "config.h"
@@ -22,6 +23,31 @@
 static unsigned char *heap;                 /* Starting address of heap */
 static unsigned char *mem_brk;              /* Current position of break */
 static unsigned char *mem_max_addr;         /* Maximum allowable heap address */
+static size_t heap_len;                     /* Length of the heap mapping */
+
+/*
+ * File-backed heaps.  The first page of the file holds the saved
+ * break and the allocator's root area; the heap follows it.
+ */
+#define MEM_FILE_MAGIC 0x6d6d686561700001ull
+#define MEM_FILE_CHUNK (1ul << 20)          /* file grows in 1MB steps */
+
+typedef struct {
+    uint64_t magic;
+    uint64_t brk;                           /* heap bytes in use */
+    unsigned char root[MEM_ROOT_SIZE];      /* see mm_root */
+} mem_file_hdr_t;
+
+static const char *heap_path = NULL;        /* backing file, NULL if anonymous */
+static int heap_fd = -1;
+static mem_file_hdr_t *heap_hdr = NULL;     /* mapped first page of the file */
+static size_t heap_file_len = 0;            /* heap bytes the file can hold */
+
+/* Page size backing the heap, see mem_set_pages */
+#define MEM_HUGE_DEFAULT (2ul << 20)
+static int heap_pages = MEM_PAGES_NORMAL;
+static bool heap_hugetlb = false;           /* heap mapped with MAP_HUGETLB */
+static bool huge_warned = false;
 
 /* 
  * mm_sbrk - simple model of the sbrk function. Extends the heap 
@@ -39,6 +65,16 @@ void *mm_sbrk(intptr_t incr) {
 	ok = false;
 	long alloc = mem_brk - heap + incr;
 	fprintf(stderr, "ERROR: mm_sbrk failed. Ran out of memory.  Would require heap size of %zd (0x%zx) bytes\n", alloc, alloc);
+    } else if (heap_fd >= 0 && (size_t)(mem_brk - heap + incr) > heap_file_len) {
+	/* Touching the mapping past the end of the file would SIGBUS */
+	size_t len = (size_t)(mem_brk - heap + incr);
+	len = (len + MEM_FILE_CHUNK - 1) / MEM_FILE_CHUNK * MEM_FILE_CHUNK;
+	if (ftruncate(heap_fd, (off_t)(mem_pagesize() + len)) != 0) {
+	    ok = false;
+	    fprintf(stderr, "ERROR: mm_sbrk failed. Could not grow heap file to %zu bytes\n", len);
+	} else {
+	    heap_file_len = len;
+	}
     }
     if (ok) {
 	mem_brk += incr;
@@ -77,6 +113,117 @@ size_t mm_pagesize(){
     return (size_t) getpagesize();
 }
 
+/*
+ * mm_root - return MEM_ROOT_SIZE bytes that are saved with a
+ *           file-backed heap, or NULL if the heap is anonymous
+ */
+void *mm_root(void) {
+    return heap_hdr ? (void *) heap_hdr->root : NULL;
+}
+
+/*
+ * mm_heap_sync - record the break and flush a file-backed heap to disk
+ */
+bool mm_heap_sync(void) {
+    if (!heap_hdr)
+        return false;
+    heap_hdr->brk = (uint64_t)(mem_brk - heap);
+    if (msync(heap, (size_t)(mem_brk - heap), MS_SYNC) != 0 ||
+        msync(heap_hdr, mem_pagesize(), MS_SYNC) != 0) {
+        fprintf(stderr, "ERROR: mm_heap_sync failed: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/*
+ * range_resident - return how many bytes of the pages in [lo, lo+len)
+ *                  are resident; lo must be page aligned
+ */
+static size_t range_resident(unsigned char *lo, size_t len) {
+    unsigned char vec[256];
+    size_t page = mem_pagesize();
+    size_t pages = (len + page - 1) / page;
+    size_t i, n, resident = 0;
+
+    while (pages > 0) {
+        n = pages < sizeof(vec) ? pages : sizeof(vec);
+        if (mincore(lo, n * page, vec) != 0)
+            return 0;
+        for (i = 0; i < n; i++)
+            resident += vec[i] & 1;
+        lo += n * page;
+        pages -= n;
+    }
+    return resident * page;
+}
+
+/*
+ * mm_release - tell the kernel the whole pages inside [addr, addr+len)
+ *              hold nothing worth keeping.  They read back as zeroes
+ *              (or the file contents) when touched again.  Returns
+ *              the number of bytes that were resident, so pages
+ *              released before and not touched since count once.
+ */
+size_t mm_release(void *addr, size_t len) {
+    size_t page = heap_hugetlb ? mm_hugepagesize() : mem_pagesize();
+    uintptr_t lo = ((uintptr_t) addr + page - 1) / page * page;
+    uintptr_t hi = ((uintptr_t) addr + len) / page * page;
+    size_t resident;
+
+    if (hi <= lo)
+        return 0;
+    resident = range_resident((unsigned char *) lo, hi - lo);
+    if (madvise((void *) lo, hi - lo, MADV_DONTNEED) != 0)
+        return 0;
+    return resident;
+}
+
+/*
+ * mem_resident - return how many bytes of the heap are resident in
+ *                memory, i.e. were touched and not given back
+ */
+size_t mem_resident(void) {
+    return range_resident(heap, (size_t)(mem_brk - heap));
+}
+
+/*
+ * mem_meminfo - return the value of key in /proc/meminfo, 0 if missing
+ */
+static size_t mem_meminfo(const char *key) {
+    char line[128];
+    size_t value = 0;
+    size_t keylen = strlen(key);
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (!f)
+        return 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, key, keylen) == 0) {
+            value = strtoull(line + keylen, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+/*
+ * mm_hugepagesize - return the huge page size if the heap is backed by
+ *                   huge pages, so the allocator can grow in whole
+ *                   huge pages, or 0 with normal pages
+ */
+size_t mm_hugepagesize(void) {
+    static size_t huge = 0;
+    if (heap_pages == MEM_PAGES_NORMAL)
+        return 0;
+    if (huge == 0) {
+        huge = mem_meminfo("Hugepagesize:") * 1024;
+        if (huge == 0)
+            huge = MEM_HUGE_DEFAULT;
+    }
+    return huge;
+}
+
 /*
  * mm_memcpy - copies n bytes from src to dst
  */
@@ -122,33 +269,207 @@ void *mm_memset(void *dst, int c, size_t n) {
 
 /*************** Memory emulation  *******************/
 
+/*
+ * mem_set_pages - choose the pages backing heaps created by later
+ *                 mem_init calls: MEM_PAGES_NORMAL, MEM_PAGES_THP
+ *                 (transparent huge pages via madvise) or
+ *                 MEM_PAGES_HUGETLB (explicit huge pages, falling back
+ *                 to THP if the kernel has none to give)
+ */
+void mem_set_pages(int mode){
+    heap_pages = mode;
+}
+
+/*
+ * mem_pages - return the pages backing the heap of the last mem_init,
+ *             MEM_PAGES_THP if MEM_PAGES_HUGETLB had to fall back
+ */
+int mem_pages(void){
+    if (heap_hugetlb)
+        return MEM_PAGES_HUGETLB;
+    return heap_pages == MEM_PAGES_NORMAL ? MEM_PAGES_NORMAL : MEM_PAGES_THP;
+}
+
+/*
+ * mem_advise_huge - ask for transparent huge pages on the heap
+ */
+static void mem_advise_huge(void){
+    if (madvise(heap, heap_len, MADV_HUGEPAGE) != 0 && !huge_warned) {
+        fprintf(stderr, "Warning: madvise(MADV_HUGEPAGE) failed: %s\n", strerror(errno));
+        huge_warned = true;
+    }
+}
+
+/*
+ * mem_set_file - back heaps created by later mem_init calls with the
+ *                file at path, or with anonymous memory if path is NULL
+ */
+void mem_set_file(const char *path){
+    heap_path = path;
+}
+
+/*
+ * mem_map_file - open the backing file and map its header and heap.
+ *                With truncate, any previous heap in the file is discarded.
+ */
+static bool mem_map_file(bool truncate){
+    size_t page = mem_pagesize();
+    struct stat st;
+
+    heap_fd = open(heap_path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0600);
+    if (heap_fd < 0 || fstat(heap_fd, &st) != 0) {
+        fprintf(stderr, "FAILURE.  couldn't open heap file '%s': %s\n",
+                heap_path, strerror(errno));
+        exit(1);
+    }
+    if ((size_t) st.st_size < page) {
+        if (!truncate || ftruncate(heap_fd, (off_t) page) != 0)
+            goto fail;
+        st.st_size = (off_t) page;
+    }
+    heap_hdr = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, heap_fd, 0);
+    if (heap_hdr == MAP_FAILED) {
+        heap_hdr = NULL;
+        goto fail;
+    }
+    if (truncate) {
+        heap_hdr->magic = MEM_FILE_MAGIC;
+        heap_hdr->brk = 0;
+    } else if (heap_hdr->magic != MEM_FILE_MAGIC ||
+               heap_hdr->brk > (uint64_t)(st.st_size - page)) {
+        goto fail;
+    }
+    heap_file_len = (size_t) st.st_size - page;
+    /* The mapping may run past the end of the file; mm_sbrk grows the file first */
+    heap = mmap(NULL, MAX_HEAP_SIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_NORESERVE, heap_fd, (off_t) page);
+    if (heap == MAP_FAILED) {
+        fprintf(stderr, "FAILURE.  mmap couldn't map heap file '%s'\n", heap_path);
+        exit(1);
+    }
+    heap_len = MAX_HEAP_SIZE;
+    heap_hugetlb = false;
+    mem_max_addr = heap + heap_len;
+    mem_brk = heap + heap_hdr->brk;
+    if (heap_pages != MEM_PAGES_NORMAL)
+        mem_advise_huge();
+    return true;
+
+ fail:
+    if (heap_hdr)
+        munmap(heap_hdr, page);
+    heap_hdr = NULL;
+    close(heap_fd);
+    heap_fd = -1;
+    return false;
+}
+
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(){
-    unsigned char* addr = mmap(NULL,                                        /* start*/
-                               MAX_HEAP_SIZE,                               /* length */
-                               PROT_READ | PROT_WRITE,                      /* permissions */
-                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, /* flags */
-                               -1,                                          /* fd */
-                               0);                                          /* offset */
-    if (addr == MAP_FAILED) {
-	fprintf(stderr, "FAILURE.  mmap couldn't allocate space for heap\n");
-	exit(1);
-    }
-    heap = addr;
-    mem_max_addr = addr + MAX_HEAP_SIZE;
+    if (heap_path) {
+        if (!mem_map_file(true)) {
+            fprintf(stderr, "FAILURE.  couldn't create heap file '%s'\n", heap_path);
+            exit(1);
+        }
+        return;
+    }
+    size_t huge = mm_hugepagesize();
+    unsigned char* addr = MAP_FAILED;
+    if (heap_pages == MEM_PAGES_HUGETLB) {
+        /* Reserve the free pool up front; touching an unreserved
+           hugetlb page with an empty pool would SIGBUS */
+        heap_len = mem_meminfo("HugePages_Free:") * huge;
+        if (heap_len > MAX_HEAP_SIZE)
+            heap_len = MAX_HEAP_SIZE;
+        if (heap_len > 0)
+            addr = mmap(NULL, heap_len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr == MAP_FAILED && !huge_warned) {
+            fprintf(stderr, "Warning: no hugetlb pages available, using transparent huge pages\n");
+            huge_warned = true;
+        }
+    }
+    heap_hugetlb = (addr != MAP_FAILED);
+    if (addr != MAP_FAILED) {
+        heap = addr;
+    } else {
+        heap_len = MAX_HEAP_SIZE;
+        /* Over-map by a huge page so the heap can start on a huge page boundary */
+        addr = mmap(NULL,                                        /* start*/
+                    MAX_HEAP_SIZE + huge,                        /* length */
+                    PROT_READ | PROT_WRITE,                      /* permissions */
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, /* flags */
+                    -1,                                          /* fd */
+                    0);                                          /* offset */
+        if (addr == MAP_FAILED) {
+            fprintf(stderr, "FAILURE.  mmap couldn't allocate space for heap\n");
+            exit(1);
+        }
+        heap = addr;
+        if (huge) {
+            size_t lead = (huge - (uintptr_t) addr % huge) % huge;
+            heap = addr + lead;
+            if (lead)
+                munmap(addr, lead);
+            if (huge - lead)
+                munmap(heap + heap_len, huge - lead);
+            mem_advise_huge();
+        }
+    }
+    mem_max_addr = heap + heap_len;
     mem_reset_brk();
 }
 
+/*
+ * mem_restore - map the heap saved in the file given to mem_set_file,
+ *               possibly at a different address than before.  With
+ *               move set the old base is held while mapping, so the
+ *               heap always comes back somewhere else.  Returns false
+ *               if the file holds no saved heap.
+ */
+bool mem_restore(bool move){
+    void *hold = MAP_FAILED;
+    bool ok;
+
+    if (!heap_path)
+        return false;
+    /* The old heap is unmapped, so the hint is honoured and the
+       remaining gap is too small for a new heap */
+    if (move)
+        hold = mmap(heap, mem_pagesize(), PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ok = mem_map_file(false);
+    if (hold != MAP_FAILED)
+        munmap(hold, mem_pagesize());
+    return ok;
+}
+
 /* 
  * mem_deinit - free the storage used by the memory system model
  */
 void mem_deinit(void){
-    if (munmap(heap, MAX_HEAP_SIZE) != 0) {
+    if (munmap(heap, heap_len) != 0) {
         fprintf(stderr, "FAILURE.  munmap couldn't deallocate heap space\n");
         exit(1);
     }
+    if (heap_hdr) {
+        munmap(heap_hdr, mem_pagesize());
+        close(heap_fd);
+        heap_hdr = NULL;
+        heap_fd = -1;
+    }
+}
+
+/*
+ * mem_release - give every page of an anonymous heap back to the
+ *               kernel, so mem_resident starts from zero.  A
+ *               file-backed heap stays in the page cache regardless.
+ */
+void mem_release(void){
+    if (heap_fd < 0 && mem_brk > heap)
+        madvise(heap, (size_t)(mem_brk - heap), MADV_DONTNEED);
 }
 
 /*
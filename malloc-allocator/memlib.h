@@ -9,16 +9,30 @@ void *mm_heap_lo(void);
 void *mm_heap_hi(void);
 size_t mm_heapsize(void);
 size_t mm_pagesize(void);
+size_t mm_hugepagesize(void);
+size_t mm_release(void *addr, size_t len);
 void *mm_memcpy(void *dst, const void *src, size_t n);
 void *mm_memset(void *dst, int c, size_t n);
 
+/* Persistent heaps: bytes saved alongside a file-backed heap */
+#define MEM_ROOT_SIZE 512
+void *mm_root(void);
+bool mm_heap_sync(void);
+
 /* Functions used for memory emulation */
 /* You should not be calling these functions */
 
 void mem_init();               
 void mem_deinit(void);
+void mem_set_file(const char *path);
+enum { MEM_PAGES_NORMAL, MEM_PAGES_THP, MEM_PAGES_HUGETLB };
+void mem_set_pages(int mode);
+int mem_pages(void);
+bool mem_restore(bool move);
 void *mem_sbrk(intptr_t incr);
 void mem_reset_brk(void); 
+void mem_release(void);
+size_t mem_resident(void);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# mkclasses.py - build a segregated-list size-class table from traces
+#
+# Reads one or more .rep traces, histograms the block sizes mm.c would
+# carve for every malloc/realloc request, and writes a header with the
+# upper bound of each size class.  Boundaries are chosen at equal-count
+# quantiles, so every list sees roughly the same share of requests.
+#
+# Usage: ./mkclasses.py traces/*.rep > sizeclasses.h
+#
+
+import sys
+from collections import Counter
+
+NUM_LISTS = 7     # must match NUM_LISTS in mm.c
+ALIGNMENT = 16
+MIN_BLOCK = 32
+OVERHEAD = 16     # header + footer
+
+
+def block_size(size):
+    space = size + OVERHEAD
+    space = ALIGNMENT * ((space + ALIGNMENT - 1) // ALIGNMENT)
+    return max(space, MIN_BLOCK)
+
+
+def read_sizes(path, hist):
+    with open(path) as f:
+        header = [next(f) for _ in range(4)]
+        num_ops = int(header[2])
+        for n, line in enumerate(f):
+            if n == num_ops:
+                break
+            fields = line.split()
+            if fields and fields[0] in ("a", "r") and int(fields[2]) > 0:
+                hist[block_size(int(fields[2]))] += 1
+
+
+def class_limits(hist):
+    total = sum(hist.values())
+    limits = []
+    cum = 0
+    k = 1
+    for size in sorted(hist):
+        cum += hist[size]
+        while k < NUM_LISTS and cum * NUM_LISTS >= k * total:
+            limits.append(size)
+            k += 1
+    # every list needs its own, strictly increasing bound
+    for i in range(len(limits), NUM_LISTS - 1):
+        limits.append(limits[-1] * 2 if limits else MIN_BLOCK)
+    for i in range(1, len(limits)):
+        if limits[i] <= limits[i - 1]:
+            limits[i] = limits[i - 1] + ALIGNMENT
+    return limits[:NUM_LISTS - 1]
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write("usage: %s <trace.rep>...\n" % argv[0])
+        return 1
+    hist = Counter()
+    for path in argv[1:]:
+        read_sizes(path, hist)
+    if not hist:
+        sys.stderr.write("%s: no allocation requests found\n" % argv[0])
+        return 1
+    limits = class_limits(hist)
+    print("/*")
+    print(" * sizeclasses.h - generated by mkclasses.py from %d trace(s)" % (len(argv) - 1))
+    print(" * and %d requests.  Do not edit; rerun 'make classes'." % sum(hist.values()))
+    print(" */")
+    print("#ifndef __SIZECLASSES_H_")
+    print("#define __SIZECLASSES_H_")
+    print("")
+    print("#define SIZECLASS_LIMITS {%s}" % ", ".join(str(x) for x in limits))
+    print("")
+    print("#endif /* __SIZECLASSES_H_ */")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
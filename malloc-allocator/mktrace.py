@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+#
+# mktrace.py - generate a synthetic allocator trace from a parameter file
+#
+# Writes a .rep trace (see traces/README), or with -b the binary format
+# mdriver also reads.  The parameter file holds global settings followed
+# by one or more [phase] sections, each run for its share of the ops:
+#
+#   seed = 1
+#   weight = 1
+#   ops = 20000                 # total requests, frees included
+#
+#   [phase]
+#   share = 0.7                 # fraction of the ops, shares are normalised
+#   sizes = powerlaw 16 4096 1.5        # min max alpha
+#   sizes = bimodal 32 2048 0.8         # small large p(small)
+#   sizes = empirical hist.txt          # lines of "<bytes> <count>"
+#   lifetime = exp 200          # ops until freed: exp <mean>, uniform <lo> <hi>,
+#                               # powerlaw <min> <max> <alpha> or forever
+#   realloc = 0.05 1.5          # p(realloc a live block), growth factor
+#
+# A later "sizes" line in a phase replaces an earlier one.  Blocks still
+# live at the end are freed, so every id is freed exactly once.  The trace
+# has exactly ops requests, or one fewer if ops is odd and no phase
+# reallocs, since every block then takes an alloc and a free.
+#
+# Usage: ./mktrace.py [-b] <params> > out.rep
+#
+
+import bisect
+import heapq
+import math
+import random
+import struct
+import sys
+
+BIN_MAGIC = b"MMTRACE1"     # must match BIN_TRACE_MAGIC in mdriver.c
+BIN_HEADER = "<IIIIQ"       # weight num_ids num_ops reserved data_bytes
+BIN_OP = "<BBHiiIQ"         # type tid reserved dep index reserved size
+
+
+class Sampler:
+    """Draws integers from one of the distributions a phase can name."""
+
+    def __init__(self, rng, spec, what):
+        self.rng = rng
+        self.kind = spec[0] if spec else ""
+        self.args = spec[1:]
+        if self.kind == "empirical":
+            self.load_histogram(self.args[0])
+        elif self.kind not in ("powerlaw", "bimodal", "exp", "uniform",
+                               "fixed", "forever"):
+            raise ValueError("unknown %s distribution '%s'" % (what, self.kind))
+
+    def load_histogram(self, path):
+        self.values, self.cum = [], []
+        total = 0
+        with open(path) as f:
+            for line in f:
+                fields = line.split("#")[0].split()
+                if len(fields) == 2:
+                    total += int(fields[1])
+                    self.values.append(int(fields[0]))
+                    self.cum.append(total)
+        if total == 0:
+            raise ValueError("%s: empty histogram" % path)
+
+    def powerlaw(self, lo, hi, alpha):
+        # inverse transform of p(x) ~ x^-alpha on [lo, hi]
+        u = self.rng.random()
+        if alpha == 1.0:
+            return lo * math.exp(u * math.log(hi / lo))
+        a = 1.0 - alpha
+        return (lo ** a + u * (hi ** a - lo ** a)) ** (1.0 / a)
+
+    def draw(self):
+        a = [float(x) for x in self.args] if self.kind != "empirical" else []
+        if self.kind == "powerlaw":
+            return int(self.powerlaw(a[0], a[1], a[2]))
+        if self.kind == "bimodal":
+            return int(a[0] if self.rng.random() < a[2] else a[1])
+        if self.kind == "empirical":
+            i = bisect.bisect_left(self.cum, self.rng.randrange(self.cum[-1]) + 1)
+            return self.values[i]
+        if self.kind == "exp":
+            return int(self.rng.expovariate(1.0 / a[0])) + 1
+        if self.kind == "uniform":
+            return self.rng.randint(int(a[0]), int(a[1]))
+        if self.kind == "fixed":
+            return int(a[0])
+        return None     # forever
+
+
+def read_params(path):
+    settings, phases = {}, []
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            line = line.split("#")[0].strip()
+            if not line:
+                continue
+            if line == "[phase]":
+                phases.append({"share": "1", "sizes": "powerlaw 16 4096 1.5",
+                               "lifetime": "exp 100", "realloc": "0 1"})
+                continue
+            if "=" not in line:
+                raise ValueError("%s:%d: expected key = value" % (path, n))
+            key, value = (x.strip() for x in line.split("=", 1))
+            (phases[-1] if phases else settings)[key] = value
+    if not phases:
+        raise ValueError("%s: no [phase] sections" % path)
+    return settings, phases
+
+
+def generate(settings, phases):
+    rng = random.Random(int(settings.get("seed", "1")))
+    total_ops = int(settings.get("ops", "10000"))
+    shares = [float(p["share"]) for p in phases]
+    ops = []            # (type, id, size)
+    live = {}           # id -> size
+    live_ids = []       # ids of live blocks, for picking realloc victims
+    slot = {}           # id -> position in live_ids
+    deaths = []         # heap of (op number, id)
+    next_id = 0
+    bytes_live = peak = 0
+
+    def free(i):
+        nonlocal bytes_live
+        bytes_live -= live.pop(i)
+        last = live_ids.pop()
+        if last != i:
+            live_ids[slot[i]] = last
+            slot[last] = slot[i]
+        del slot[i]
+        ops.append(("f", i, 0))
+
+    done = 0.0
+    for p, share in zip(phases, shares):
+        sizes = Sampler(rng, p["sizes"].split(), "size")
+        lifetime = Sampler(rng, p["lifetime"].split(), "lifetime")
+        realloc_p, growth = (float(x) for x in p["realloc"].split())
+        # phases end at their running share of the total, so the frees owed
+        # by blocks still live at a boundary come out of the next phase
+        done += share
+        end = round(total_ops * done / sum(shares))
+        # leave room to free whatever is still live at the end
+        while len(ops) + len(live) < end:
+            if deaths and deaths[0][0] <= len(ops):
+                _, i = heapq.heappop(deaths)
+                if i in live:
+                    free(i)
+                continue
+            grow = live_ids and rng.random() < realloc_p
+            if not grow and end - len(ops) - len(live) < 2:
+                # an alloc needs room for its free too, only a realloc fits
+                if not (live_ids and realloc_p > 0):
+                    break
+                grow = True
+            if grow:
+                i = rng.choice(live_ids)
+                size = max(1, int(live[i] * growth))
+                bytes_live += size - live[i]
+                live[i] = size
+                ops.append(("r", i, size))
+            else:
+                i, next_id = next_id, next_id + 1
+                size = max(1, sizes.draw())
+                live[i] = size
+                slot[i] = len(live_ids)
+                live_ids.append(i)
+                bytes_live += size
+                ops.append(("a", i, size))
+                life = lifetime.draw()
+                if life is not None:
+                    heapq.heappush(deaths, (len(ops) + life, i))
+            peak = max(peak, bytes_live)
+    for i in list(live_ids):
+        free(i)
+    return next_id, peak, ops
+
+
+def write_rep(out, weight, num_ids, peak, ops):
+    out.write("%d\n%d\n%d\n%d\n" % (weight, num_ids, len(ops), peak))
+    for kind, i, size in ops:
+        out.write("f %d\n" % i if kind == "f" else "%s %d %d\n" % (kind, i, size))
+
+
+def write_bin(out, weight, num_ids, peak, ops):
+    out.write(BIN_MAGIC)
+    out.write(struct.pack(BIN_HEADER, weight, num_ids, len(ops), 0, peak))
+    for kind, i, size in ops:
+        out.write(struct.pack(BIN_OP, ord(kind), 0, 0, -1, i, 0, size))
+
+
+def main(argv):
+    binary = len(argv) > 1 and argv[1] == "-b"
+    args = argv[2:] if binary else argv[1:]
+    if len(args) != 1:
+        sys.stderr.write("usage: %s [-b] <params>\n" % argv[0])
+        return 1
+    try:
+        settings, phases = read_params(args[0])
+        num_ids, peak, ops = generate(settings, phases)
+    except (OSError, ValueError, IndexError) as e:
+        sys.stderr.write("%s: %s\n" % (argv[0], e))
+        return 1
+    if num_ids == 0:
+        sys.stderr.write("%s: no allocations generated\n" % argv[0])
+        return 1
+    weight = int(settings.get("weight", "1"))
+    if binary:
+        write_bin(sys.stdout.buffer, weight, num_ids, peak, ops)
+    else:
+        write_rep(sys.stdout, weight, num_ids, peak, ops)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -18,6 +18,7 @@
 
 #include "mm.h"
 #include "memlib.h"
+#include "sizeclasses.h"
 
 /*
  * If you want to enable your debugging output and heap checker code,
@@ -48,12 +49,67 @@
 #endif // DRIVER
 
 #define ALIGNMENT 16
-#define NUM_LISTS 7
+#define NUM_LISTS MM_NUM_LISTS
+#define CLASS_GRANULES 256 //adaptive histogram covers blocks up to 4KB
+#define CLASS_WARMUP 4096 //mallocs sampled before adaptive classes rebuild
 
 //globals and constants
 static char* hlst_ptr = NULL; //heap list pointer
+static char* heap_base = NULL; //free list links are offsets from here
 //static char* free_list_ptr = NULL; //free list pointer
 static char* seg_lists[NUM_LISTS]; //segregated approach
+static char* seg_rovers[NUM_LISTS]; //next fit resumes here
+static mm_stats_t heap_stats; //counters for mm_stats, kept up to date inline
+static bool coalescing = false; //merge neighbouring free blocks, see mm_set_coalescing
+static size_t grow_chunk = 0; //huge page size when memlib uses huge pages
+
+//BIBOP small objects, see mm_set_bibop. Page-aligned runs of RUN_PAGES
+//pages each hold headerless objects of one class, 16 * class bytes.
+//page_table, a block in the heap with a byte per page from heap_base,
+//records the class of every run page and 0 for any other page
+#define BIBOP_PAGE 4096
+#define BIBOP_CLASSES 8 //16, 32, ..., 128 byte objects
+#define RUN_PAGES 4
+static bool bibop = false;
+static uint8_t* page_table = NULL;
+static size_t page_table_len = 0; //pages covered by page_table
+static char* small_lists[BIBOP_CLASSES]; //free objects of each class
+
+//realloc growth hints, see mm_set_realloc_growth. GROWN in the header
+//and footer marks a block realloc has already moved to grow it
+#define GROWN 0x2
+#define GROW_MAX_SLACK (1 << 20)
+static bool realloc_growth = false;
+
+//page release, see mm_set_purge. Free blocks of at least purge_threshold
+//bytes keep the clock tick they were freed at after their links
+#define PURGED UINT64_MAX //stamp of a block whose pages are already released
+static size_t purge_threshold = 0;
+static size_t purge_decay = 0;
+static uint64_t purge_clock = 0; //counts malloc and free calls
+static uint64_t next_purge = 0;
+
+//incremental mm_checkheap, blocks touched since the last check
+#define CHECK_RING 4096
+static bool check_incremental = false;
+static char* touched[CHECK_RING];
+static size_t num_touched = 0;
+
+//placement policy, see mm_set_policy
+#define FIT_SEARCH_CAP 64 //blocks first fit examines per list before moving on
+static int fit_policy = MM_FIT_FIRST;
+static int good_fit_k = 8;
+static bool insert_by_addr = false;
+
+//upper bound of every list but the last, which takes the rest
+static const size_t default_limits[NUM_LISTS - 1] = {32, 64, 128, 256, 512, 1024};
+static const size_t tuned_limits[NUM_LISTS - 1] = SIZECLASS_LIMITS;
+static size_t class_limits[NUM_LISTS - 1];
+static int class_mode = MM_CLASSES_DEFAULT;
+
+//adaptive mode, block sizes in 16 byte granules, last slot is overflow
+static size_t class_hist[CLASS_GRANULES + 1];
+static size_t class_samples = 0;
 
 //helper functions
 static size_t get_size(void* ptr) {
@@ -66,12 +122,16 @@ static bool get_alloc(void* ptr) {
 	return (value & 0x1) != 0;
 }
 
+//links are stored as offsets from heap_base, 0 for NULL, so a heap
+//mapped at a new address by mem_restore stays valid
 static void* get_prev(void* ptr) {
-	return *(void**)ptr;
+	uint64_t offset = *(uint64_t*)ptr;
+	return offset ? heap_base + offset : NULL;
 }
 
 static void* get_next(void* ptr) {
-	return *(void**)((char*)ptr + 8);
+	uint64_t offset = *(uint64_t*)((char*)ptr + 8);
+	return offset ? heap_base + offset : NULL;
 }
 
 static void set_size(void* ptr, size_t size) {
@@ -95,12 +155,36 @@ static void set_alloc(void* ptr, bool alloc) {
 }
 
 static void set_prev(void* ptr, void* prev_ptr) {
-	*(void**)ptr = prev_ptr;
+	*(uint64_t*)ptr = prev_ptr ? (uint64_t)((char*)prev_ptr - heap_base) : 0;
 }
 
 static void set_next(void* ptr, void* next_ptr) {
 //	printf("[set_next] ptr=%p => next=%p\n", ptr, next_ptr);
-	*(void**)((char*)ptr + 8) = next_ptr;
+	*(uint64_t*)((char*)ptr + 8) = next_ptr ? (uint64_t)((char*)next_ptr - heap_base) : 0;
+}
+
+static void* coalesce(void* ptr);
+
+//remember a block for the next incremental mm_checkheap
+static void touch(void* ptr) {
+	if (num_touched < CHECK_RING) {
+		touched[num_touched] = ptr;
+	}
+	num_touched++;
+}
+
+//a block merged into its neighbour no longer starts a block
+static void forget(void* ptr) {
+	//only incremental checks read the ring, and once it overflows the next
+	//check walks the whole heap anyway
+	if (!check_incremental || num_touched > CHECK_RING) {
+		return;
+	}
+	for (size_t i = 0; i < num_touched; i++) {
+		if (touched[i] == ptr) {
+			touched[i] = NULL;
+		}
+	}
 }
 
 // rounds up to the nearest multiple of ALIGNMENT
@@ -110,25 +194,113 @@ static size_t align(size_t x)
 }
 
 static int get_list(size_t size) {
-	if (size <= 32) { return 0;}
-	if (size <= 64) { return 1;}
-	if (size <= 128) { return 2;}
-	if (size <= 256) { return 3;}
-	if (size <= 512) { return 4;}
-	if (size <= 1024) { return 5;}
-	return 6;
+	for (int i = 0; i < NUM_LISTS - 1; i++) {
+		if (size <= class_limits[i]) { return i;}
+	}
+	return NUM_LISTS - 1;
 }
 
-static void insert_block(void* ptr) {
-        //insert to begining of list
+static void purge_block(char* ptr, size_t size);
+
+//stamp is the tick the block was freed at, or PURGED if its pages are
+//already released
+static void insert_block(void* ptr, uint64_t stamp) {
         size_t size = get_size(ptr);
-        char* head = seg_lists[ get_list(size)];
+        int index = get_list(size);
+        char* head = seg_lists[index];
+        heap_stats.free_bytes[index] += size;
+        heap_stats.free_blocks[index]++;
+        if (purge_threshold != 0 && size >= purge_threshold) {
+                *(uint64_t*)((char*)ptr + 16) = stamp;
+                if (purge_decay == 0) {
+                        purge_block(ptr, size);
+                }
+        }
+        if (insert_by_addr && head != NULL && (char*)ptr > head) {
+                //address ordered, walk to the last block below ptr
+                char* prev = head;
+                char* next = get_next(prev);
+                while (next != NULL && next < (char*)ptr) {
+                        prev = next;
+                        next = get_next(next);
+                }
+                set_prev(ptr, prev);
+                set_next(ptr, next);
+                set_next(prev, ptr);
+                if (next != NULL) {
+                        set_prev(next, ptr);
+                }
+                return;
+        }
+        //insert to begining of list
         set_next(ptr, head);
         set_prev(ptr, NULL);
         if (head != NULL) {
                 set_prev(head, ptr);
         }
-        head = ptr;
+        seg_lists[index] = ptr;
+}
+
+//pick limits at equal count quantiles of the sampled block sizes
+static void compute_limits(void) {
+	size_t cum = 0;
+	int k = 1;
+	for (int g = 0; g <= CLASS_GRANULES && k < NUM_LISTS; g++) {
+		cum += class_hist[g];
+		while (k < NUM_LISTS && cum * NUM_LISTS >= k * class_samples) {
+			class_limits[k - 1] = (size_t)g * 16;
+			k++;
+		}
+	}
+	//every list needs its own, strictly increasing bound
+	for (int i = 0; i < NUM_LISTS - 1; i++) {
+		size_t floor = (i == 0) ? 32 : class_limits[i - 1] + 16;
+		if (class_limits[i] < floor) {
+			class_limits[i] = floor;
+		}
+	}
+}
+
+//move every free block to the list its size belongs in under new limits
+static void rebuild_classes(void) {
+	char* pending = NULL;
+	for (int i = 0; i < NUM_LISTS; i++) {
+		char* block = seg_lists[i];
+		while (block != NULL) {
+			char* next = get_next(block);
+			set_next(block, pending);
+			pending = block;
+			block = next;
+		}
+		seg_lists[i] = NULL;
+		seg_rovers[i] = NULL;
+		heap_stats.free_bytes[i] = 0;
+		heap_stats.free_blocks[i] = 0;
+	}
+	compute_limits();
+	while (pending != NULL) {
+		char* next = get_next(pending);
+		insert_block(pending, *(uint64_t*)(pending + 16));
+		pending = next;
+	}
+}
+
+static void sample_class(size_t space) {
+	size_t g = space / 16;
+	class_hist[g < CLASS_GRANULES ? g : CLASS_GRANULES]++;
+	if (++class_samples == CLASS_WARMUP) {
+		rebuild_classes();
+	}
+}
+
+/*
+ * mm_set_size_classes: select the size-class table used by the next
+ * mm_init. MM_CLASSES_ADAPTIVE starts from the default table and
+ * rebuilds it from the first CLASS_WARMUP requests.
+ */
+void mm_set_size_classes(int mode)
+{
+	class_mode = mode;
 }
 
 static void* extend_heap(size_t size)
@@ -143,25 +315,39 @@ static void* extend_heap(size_t size)
                 space = 32;
         }
 
+	//with huge pages, grow to the next huge page boundary so the
+	//heap is covered by whole huge pages
+	if (grow_chunk != 0) {
+		size_t end = mm_heapsize() + space;
+		space += (grow_chunk - end % grow_chunk) % grow_chunk;
+	}
+
 	//mm_sbrk
 	char* ptr = mm_sbrk(space);
 	if (ptr == (void*)-1) {
 		return NULL;
 	}
+	heap_stats.extend_calls++;
+	heap_stats.sbrk_bytes += space;
 	//init block
 	set_size(ptr, space);
 	set_alloc(ptr, false);
-	insert_block(ptr);
-	
 
 	//epilogue
 	*(uint64_t*)((char*)ptr + space - 8) = 0x1;
+
+	if (coalescing) {
+		ptr = coalesce(ptr);
+	}
+	insert_block(ptr, purge_clock);
 	return ptr;
 }
 
 static void remove_block(void* ptr) {
 	size_t size = get_size(ptr);
 	int index = get_list(size);
+	heap_stats.free_bytes[index] -= size;
+	heap_stats.free_blocks[index]--;
 	void* prev = get_prev(ptr);
 	void* next = get_next(ptr);
 	//check prev
@@ -174,6 +360,9 @@ static void remove_block(void* ptr) {
 	if (next != NULL) {
 		set_prev(next, prev);
 	}
+	if (seg_rovers[index] == ptr) {
+		seg_rovers[index] = next;
+	}
 	set_prev(ptr, NULL);
 	set_next(ptr,NULL);
 }
@@ -198,6 +387,418 @@ static bool aligned(const void* p)
 }
 	
 
+//first block in the list that is large enough, among the first FIT_SEARCH_CAP
+//a list of many small leftovers (the last class has no upper bound) would
+//otherwise be walked in full by every request that skips it
+static char* first_fit(int list, size_t space) {
+	char* block = seg_lists[list];
+	for (int steps = 0; block != NULL && steps < FIT_SEARCH_CAP; steps++) {
+		heap_stats.search_steps++;
+		if (get_size(block) >= space) {
+			return block;
+		}
+		block = get_next(block);
+	}
+	return NULL;
+}
+
+//like first fit, but resume where the last search in this list stopped
+static char* next_fit(int list, size_t space) {
+	char* start = (seg_rovers[list] != NULL) ? seg_rovers[list] : seg_lists[list];
+	for (char* block = start; block != NULL; block = get_next(block)) {
+		heap_stats.search_steps++;
+		if (get_size(block) >= space) {
+			seg_rovers[list] = block;
+			return block;
+		}
+	}
+	for (char* block = seg_lists[list]; block != start; block = get_next(block)) {
+		heap_stats.search_steps++;
+		if (get_size(block) >= space) {
+			seg_rovers[list] = block;
+			return block;
+		}
+	}
+	return NULL;
+}
+
+//smallest fit in the list, giving up after limit fits (0 means no limit)
+static char* best_fit(int list, size_t space, int limit) {
+	char* best = NULL;
+	int found = 0;
+	for (char* block = seg_lists[list]; block != NULL; block = get_next(block)) {
+		size_t block_size = get_size(block);
+		heap_stats.search_steps++;
+		if (block_size < space) {
+			continue;
+		}
+		if (best == NULL || block_size < get_size(best)) {
+			best = block;
+		}
+		if (block_size == space || ++found == limit) {
+			break;
+		}
+	}
+	return best;
+}
+
+/*
+ * mm_set_policy: select how malloc searches a list (fit, one of the
+ * MM_FIT_* values, good_k bounding the candidates MM_FIT_GOOD weighs)
+ * and whether free lists are kept in address order instead of LIFO.
+ */
+void mm_set_policy(int fit, int good_k, bool addr_ordered)
+{
+	fit_policy = fit;
+	good_fit_k = (good_k > 0) ? good_k : 1;
+	insert_by_addr = addr_ordered;
+}
+
+/*
+ * mm_set_coalescing: merge free blocks with free neighbours on free,
+ * realloc shrink and heap extension. Call before mm_init.
+ */
+void mm_set_coalescing(bool enable)
+{
+	coalescing = enable;
+}
+
+/*
+ * mm_set_bibop: serve requests of up to 16 * BIBOP_CLASSES bytes from
+ * runs of same-sized objects with no headers or footers. free finds an
+ * object's size from its page alone. Call before mm_init.
+ */
+void mm_set_bibop(bool enable)
+{
+	bibop = enable;
+}
+
+//class of a request, 0 if it is not a small object
+static int small_class(size_t size) {
+	return (size <= 16 * BIBOP_CLASSES) ? (int)((size + 15) / 16) : 0;
+}
+
+//class of the run holding ptr, 0 if ptr is not in a run
+static int page_class(const void* ptr) {
+	size_t page = (size_t)((const char*)ptr - heap_base) / BIBOP_PAGE;
+	return (page < page_table_len) ? page_table[page] : 0;
+}
+
+//free objects are linked through their first word, as heap offsets
+static char* small_next(char* obj) {
+	uint64_t offset = *(uint64_t*)obj;
+	return offset ? heap_base + offset : NULL;
+}
+
+static void small_push(int c, char* obj) {
+	*(uint64_t*)obj = small_lists[c - 1] ? (uint64_t)(small_lists[c - 1] - heap_base) : 0;
+	small_lists[c - 1] = obj;
+}
+
+//make page_table cover at least pages pages, moving it to a bigger block
+static bool grow_page_table(size_t pages) {
+	if (pages <= page_table_len) {
+		return true;
+	}
+	size_t len = page_table_len * 2;
+	if (len < pages) {
+		len = pages;
+	}
+	if (len < BIBOP_PAGE) {
+		len = BIBOP_PAGE;
+	}
+	uint8_t* table = malloc(len);
+	if (table == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < len; i++) {
+		table[i] = (i < page_table_len) ? page_table[i] : 0;
+	}
+	if (page_table != NULL) {
+		free(page_table);
+	}
+	page_table = table;
+	page_table_len = len;
+	return true;
+}
+
+//carve a run for class c out of an ordinary block. The block is split
+//so the run starts on a page boundary; what is left on either side
+//goes back on the free lists
+static bool new_run(int c) {
+	size_t run = RUN_PAGES * BIBOP_PAGE;
+	char* block = malloc(run + BIBOP_PAGE + 32);
+	if (block == NULL) {
+		return false;
+	}
+	size_t total = get_size(block);
+	size_t off = (size_t)(block - heap_base);
+	char* start = heap_base + (off + BIBOP_PAGE - 1) / BIBOP_PAGE * BIBOP_PAGE;
+	size_t front = (size_t)(start - block);
+	if (front != 0 && front < 32) {
+		//too small to stand as a free block
+		start += BIBOP_PAGE;
+		front += BIBOP_PAGE;
+	}
+	size_t size = run + 16;
+	size_t tail = total - front - size;
+	if (tail < 32) {
+		size += tail;
+		tail = 0;
+	}
+
+	//front and tail become allocated blocks of their own, then are freed
+	*(uint64_t*)(start - 8) = size | 1;
+	*(uint64_t*)(start + size - 16) = size | 1;
+	if (front != 0) {
+		*(uint64_t*)(block - 8) = front | 1;
+		heap_stats.alloc_blocks++;
+		free(block);
+	}
+	if (tail != 0) {
+		*(uint64_t*)(start + size - 8) = tail | 1;
+		heap_stats.alloc_blocks++;
+		free(start + size);
+	}
+	if (check_incremental) {
+		touch(start);
+	}
+
+	size_t first = (size_t)(start - heap_base) / BIBOP_PAGE;
+	if (!grow_page_table(first + RUN_PAGES)) {
+		return false;
+	}
+	for (size_t p = first; p < first + RUN_PAGES; p++) {
+		page_table[p] = (uint8_t)c;
+	}
+	//push from the top so objects are handed out in address order
+	size_t obj = 16 * (size_t)c;
+	for (size_t i = run / obj; i > 0; i--) {
+		small_push(c, start + (i - 1) * obj);
+	}
+	heap_stats.small_runs++;
+	return true;
+}
+
+static void* small_malloc(int c) {
+	if (small_lists[c - 1] == NULL && !new_run(c)) {
+		return NULL;
+	}
+	char* obj = small_lists[c - 1];
+	small_lists[c - 1] = small_next(obj);
+	heap_stats.small_bytes += 16 * (size_t)c;
+	return obj;
+}
+
+static void small_free(char* obj, int c) {
+	small_push(c, obj);
+	heap_stats.small_bytes -= 16 * (size_t)c;
+}
+
+/*
+ * mm_set_realloc_growth: when realloc has to move a block it already
+ * moved once to grow it, give it as much again as reserve, up to
+ * GROW_MAX_SLACK, so an appending caller copies O(log n) times. The
+ * reserve is kept while the block is at least half used and split off
+ * when it shrinks below that or is freed.
+ */
+void mm_set_realloc_growth(bool enable)
+{
+	realloc_growth = enable;
+}
+
+//mark an allocated block as grown by realloc, set_size clears the mark
+static void set_grown(void* ptr) {
+	size_t size = get_size(ptr);
+	*(uint64_t*)((char*)ptr - 8) |= GROWN;
+	*(uint64_t*)((char*)ptr + size - 16) |= GROWN;
+}
+
+/*
+ * mm_set_purge: hand the pages inside free blocks of at least threshold
+ * bytes back to the kernel once they have stayed free for decay malloc
+ * and free calls, so a block that is reused right away does not fault
+ * its pages back in. A decay of 0 releases them as soon as the block is
+ * freed. A threshold of 0 turns purging off.
+ */
+void mm_set_purge(size_t threshold, size_t decay)
+{
+	//the stamp sits after the links and must not reach the footer
+	purge_threshold = (threshold != 0 && threshold < 64) ? 64 : threshold;
+	purge_decay = decay;
+}
+
+//release the pages of a large free block not released yet. The first
+//page keeps the header, links and stamp and the last one the footer, so
+//only whole pages between them go. A block merged with purged neighbours
+//is released whole again, mm_release counts only the pages still resident
+static void purge_block(char* ptr, size_t size)
+{
+	uint64_t* stamp = (uint64_t*)(ptr + 16);
+	if (*stamp == PURGED) {
+		return;
+	}
+	size_t released = mm_release(ptr + 24, size - 40);
+	*stamp = PURGED;
+	if (released != 0) {
+		heap_stats.purges++;
+		heap_stats.purged_bytes += released;
+	}
+}
+
+//release every large block that has been free for at least purge_decay ticks
+static void purge_pass(void)
+{
+	next_purge = purge_clock + purge_decay;
+	for (int i = get_list(purge_threshold); i < NUM_LISTS; i++) {
+		for (char* ptr = seg_lists[i]; ptr != NULL; ptr = get_next(ptr)) {
+			size_t size = get_size(ptr);
+			uint64_t stamp = *(uint64_t*)(ptr + 16);
+			if (size >= purge_threshold && stamp != PURGED &&
+			    purge_clock - stamp >= purge_decay) {
+				purge_block(ptr, size);
+			}
+		}
+	}
+}
+
+//advance the purge clock, running a pass every purge_decay ticks; with no
+//decay insert_block releases blocks as they are freed
+static void purge_tick(void)
+{
+	purge_clock++;
+	if (purge_threshold != 0 && purge_decay != 0 && purge_clock >= next_purge) {
+		purge_pass();
+	}
+}
+
+/*
+ * mm_set_checkheap_incremental: make mm_checkheap look only at blocks
+ * touched since its previous call instead of walking the whole heap.
+ */
+void mm_set_checkheap_incremental(bool enable)
+{
+	check_incremental = enable;
+	num_touched = 0;
+}
+
+/*
+ * mm_stats: snapshot of the allocator counters. Average free-list
+ * search length is search_steps / searches.
+ */
+mm_stats_t mm_stats(void)
+{
+	return heap_stats;
+}
+
+/*
+ * mm_heap_walk: call fn on every block from the first to the epilogue
+ * with its payload address, its size including header and footer and
+ * whether it is allocated. A BIBOP run is one allocated block. Nothing
+ * is allocated, and fn must not call malloc, free or realloc.
+ */
+void mm_heap_walk(mm_walk_fn fn, void* ctx)
+{
+	if (hlst_ptr == NULL) {
+		return;
+	}
+	for (char* ptr = hlst_ptr + 24; get_size(ptr) != 0; ptr += get_size(ptr)) {
+		fn(ptr, get_size(ptr), get_alloc(ptr), ctx);
+	}
+}
+
+/*
+ * Allocator state saved in the memlib root area of a file-backed heap.
+ * Pointers are kept as offsets from the start of the heap.
+ */
+#define PERSIST_MAGIC 0x6d6d726f6f740001ull
+typedef struct {
+	uint64_t magic;
+	uint64_t hlst;
+	uint64_t lists[NUM_LISTS];
+	uint64_t limits[NUM_LISTS - 1];
+	uint64_t user_root;
+	uint64_t small_lists[BIBOP_CLASSES];
+	uint64_t page_table;
+	uint64_t page_table_len;
+	mm_stats_t stats;
+	bool coalescing;
+	bool bibop;
+	bool realloc_growth;
+} persist_t;
+_Static_assert(sizeof(persist_t) <= MEM_ROOT_SIZE, "persist_t outgrew the memlib root area");
+
+/*
+ * mm_checkpoint: save the allocator state and root, a pointer into the
+ * heap or NULL, with a file-backed heap and flush it to disk. Returns
+ * false if the heap is not file-backed.
+ */
+bool mm_checkpoint(void* root)
+{
+	persist_t* saved = mm_root();
+	if (saved == NULL) {
+		return false;
+	}
+	saved->hlst = hlst_ptr - heap_base;
+	for (int i = 0; i < NUM_LISTS; i++) {
+		saved->lists[i] = seg_lists[i] ? (uint64_t)(seg_lists[i] - heap_base) : 0;
+	}
+	for (int i = 0; i < NUM_LISTS - 1; i++) {
+		saved->limits[i] = class_limits[i];
+	}
+	saved->user_root = root ? (uint64_t)((char*)root - heap_base) : 0;
+	for (int c = 0; c < BIBOP_CLASSES; c++) {
+		saved->small_lists[c] = small_lists[c] ? (uint64_t)(small_lists[c] - heap_base) : 0;
+	}
+	saved->page_table = page_table ? (uint64_t)((char*)page_table - heap_base) : 0;
+	saved->page_table_len = page_table_len;
+	saved->stats = heap_stats;
+	saved->coalescing = coalescing;
+	saved->bibop = bibop;
+	saved->realloc_growth = realloc_growth;
+	saved->magic = PERSIST_MAGIC;
+	return mm_heap_sync();
+}
+
+/*
+ * mm_restore: pick up a heap saved by mm_checkpoint after mem_restore
+ * has mapped it, instead of calling mm_init. Stores the saved root
+ * in *root, translated to the heap's new address.
+ */
+bool mm_restore(void** root)
+{
+	persist_t* saved = mm_root();
+	if (saved == NULL || saved->magic != PERSIST_MAGIC) {
+		return false;
+	}
+	heap_base = mm_heap_lo();
+	grow_chunk = mm_hugepagesize();
+	hlst_ptr = heap_base + saved->hlst;
+	for (int i = 0; i < NUM_LISTS; i++) {
+		seg_lists[i] = saved->lists[i] ? heap_base + saved->lists[i] : NULL;
+		seg_rovers[i] = NULL;
+	}
+	for (int i = 0; i < NUM_LISTS - 1; i++) {
+		class_limits[i] = saved->limits[i];
+	}
+	//adaptive classes were already rebuilt, or are lost with the old run
+	class_samples = CLASS_WARMUP;
+	for (int c = 0; c < BIBOP_CLASSES; c++) {
+		small_lists[c] = saved->small_lists[c] ? heap_base + saved->small_lists[c] : NULL;
+	}
+	page_table = saved->page_table ? (uint8_t*)(heap_base + saved->page_table) : NULL;
+	page_table_len = saved->page_table_len;
+	heap_stats = saved->stats;
+	coalescing = saved->coalescing;
+	bibop = saved->bibop;
+	realloc_growth = saved->realloc_growth;
+	num_touched = 0;
+	if (root != NULL) {
+		*root = saved->user_root ? heap_base + saved->user_root : NULL;
+	}
+	return true;
+}
+
 /*
  * mm_init: returns false on error, true on success.
  */
@@ -211,6 +812,13 @@ bool mm_init(void)
 	if ((hlst_ptr = mm_sbrk(32)) == (void*)-1) {
 		return false;
 	}
+	heap_base = mm_heap_lo();
+	grow_chunk = mm_hugepagesize();
+	heap_stats = (mm_stats_t){0};
+	heap_stats.sbrk_bytes = 32;
+	num_touched = 0;
+	purge_clock = 0;
+	next_purge = purge_decay;
 	hlst_ptr += 8;
 
 	//Alignment padding, for 16 byte allignment
@@ -227,7 +835,21 @@ bool mm_init(void)
 
 	for (int i=0; i < NUM_LISTS; i++) {
 		seg_lists[i] = NULL;
+		seg_rovers[i] = NULL;
+	}
+	for (int i = 0; i < NUM_LISTS - 1; i++) {
+		class_limits[i] = (class_mode == MM_CLASSES_TUNED) ?
+			tuned_limits[i] : default_limits[i];
+	}
+	for (int g = 0; g <= CLASS_GRANULES; g++) {
+		class_hist[g] = 0;
+	}
+	class_samples = 0;
+	for (int c = 0; c < BIBOP_CLASSES; c++) {
+		small_lists[c] = NULL;
 	}
+	page_table = NULL;
+	page_table_len = 0;
 
 	//extend heap
 	if (extend_heap(1024) == NULL) {
@@ -247,6 +869,11 @@ void* malloc(size_t size)
 		return NULL;
 	}
 
+	//small objects carry no header, their run page knows the size
+	if (bibop && size <= 16 * BIBOP_CLASSES) {
+		return small_malloc(small_class(size));
+	}
+
 	//adjust size for easy 16 base + header/footer
 	size_t space = size + 16;
 	if (space % 16 != 0) {
@@ -258,6 +885,11 @@ void* malloc(size_t size)
 		space = 32;
 	}
 
+	if (class_mode == MM_CLASSES_ADAPTIVE && class_samples < CLASS_WARMUP) {
+		sample_class(space);
+	}
+	purge_tick();
+
 	//search for block
 	//find size of block, iterate through closest fit list
 	//if none found, move to larger list
@@ -266,16 +898,20 @@ void* malloc(size_t size)
 
 	//iterate through lowest sutible list, then if not found advance lists
 	char* free_block = NULL;
-	for (int i = list; i < NUM_LISTS; i++) {
-		free_block = seg_lists[i];
-		while (free_block != NULL) {
-			size_t block_size = get_size(free_block);
-			if (block_size >= space) {
-				break; //no return split later
-			}
-			free_block = get_next(free_block);
-		}
-		if (free_block != NULL) {
+	heap_stats.searches++;
+	for (int i = list; i < NUM_LISTS && free_block == NULL; i++) {
+		switch (fit_policy) {
+		case MM_FIT_NEXT:
+			free_block = next_fit(i, space);
+			break;
+		case MM_FIT_BEST:
+			free_block = best_fit(i, space, 0);
+			break;
+		case MM_FIT_GOOD:
+			free_block = best_fit(i, space, good_fit_k);
+			break;
+		default:
+			free_block = first_fit(i, space);
 			break;
 		}
 	}
@@ -296,6 +932,8 @@ void* malloc(size_t size)
 	//split logic
 	size_t needed_size = get_size(free_block);
 	if ((needed_size - space) >= 32) {
+		//the leftover was free as long as the block, and stays released if it was
+		uint64_t stamp = *(uint64_t*)(free_block + 16);
 		//create and init new block
 		set_size(free_block, space);
 		set_alloc(free_block, true);
@@ -303,12 +941,16 @@ void* malloc(size_t size)
 		size_t leftover = needed_size - space;
 		set_size(leftover_ptr, leftover);
 		set_alloc(leftover_ptr, false);
+		heap_stats.splits++;
 
 //		printf("[malloc] leftover block at %p, leftover_size=%zu\n", (void*)leftover_ptr, (size_t)get_size(leftover_ptr));
 
 		set_prev(leftover_ptr, NULL);
 		set_next(leftover_ptr, false);
-		insert_block(leftover_ptr);
+		insert_block(leftover_ptr, stamp);
+		if (check_incremental) {
+			touch(leftover_ptr);
+		}
 
 //		printf("[malloc] Setting block %p allocated, final size=%zu\n", (void*)temp_free_ptr, (size_t)get_size(temp_free_ptr));
 
@@ -316,88 +958,48 @@ void* malloc(size_t size)
 	} else {
 		set_alloc(free_block, true);
 	}
+	heap_stats.alloc_bytes += get_size(free_block);
+	heap_stats.alloc_blocks++;
+	if (check_incremental) {
+		touch(free_block);
+	}
 
 	return free_block;
 }
 
 
+/*
+ * coalesce: merge a free block that is not on any list with its free
+ * neighbours and return the start of the merged block. The prologue
+ * footer and epilogue header are marked allocated, so both neighbours
+ * can be read without bounds checks.
+ */
 static void* coalesce(void* ptr)
 {
-//	printf("[coalesce] called with ptr=%p, block_size=%zu\n", ptr, (size_t)get_size(ptr));
-	if (ptr == NULL) {
-		return NULL;
-	}
-	if (!in_heap(ptr) || !aligned(ptr)) {
-		return ptr;
-	}
-	
 	size_t size = get_size(ptr);
-	char* temp_ptr = (char*)ptr - 8;
-	
-	//check prev block
-	bool prev_alloc;
-	if ((temp_ptr - 8) < ((char*)mm_heap_lo() + 8) || !in_heap(temp_ptr - 16)) {
-		prev_alloc = true;
-	} else { uint64_t prev_footer = *(uint64_t*)(temp_ptr - 16);
-		prev_alloc = (prev_footer & 0x1) != 0;
-	}
-
-	//check next block
-	char* next_header = temp_ptr + size;
-	bool next_alloc;
-	if (!in_heap(next_header) || (next_header + 8) >(char*) mm_heap_hi()) {
-		next_alloc = true;
-	} else {
-		next_alloc = ((*(uint64_t*)next_header) & 0x1)!=0;
+	uint64_t prev_footer = *(uint64_t*)((char*)ptr - 16);
+	char* next_ptr = (char*)ptr + size;
+
+	//merge with next block
+	if (!get_alloc(next_ptr)) {
+		remove_block(next_ptr);
+		size += get_size(next_ptr);
+		heap_stats.coalesces++;
+		forget(next_ptr);
 	}
-	
 
-	//check 4 cases, do proper merger, insert into correct list
-	if (prev_alloc && next_alloc) {
-		return ptr;
-	}
-	else if (prev_alloc && !next_alloc) {
-		char* next_ptr = next_header + 8;
-		if (in_heap(next_ptr)) {
-			remove_block(next_ptr);
-			size_t next_size = get_size(next_ptr);
-			size += next_size;
-			set_size(ptr, size);
-			set_alloc(ptr, false);
-		}
-		return ptr;
-	}
-	else if (!prev_alloc && next_alloc) {
-		uint64_t prev_footer = *(uint64_t*)(temp_ptr -16);
-		size_t prev_size = prev_footer & ~(uint64_t)0xF;
-		char* prev_ptr = temp_ptr - prev_size;
-		if (in_heap(prev_ptr)) {
-			remove_block(prev_ptr);
-			size += prev_size;
-			set_size(prev_ptr, size);
-			set_alloc(prev_ptr, false);
-			ptr = prev_ptr;
-		}
-		return ptr;
-	}
-	else {
-		uint64_t prev_footer = *(uint64_t*)(temp_ptr -16);
-                size_t prev_size = prev_footer & ~(uint64_t)0xF;
-                char* prev_ptr = temp_ptr - prev_size;
-		char*next_ptr = next_header + 8;
-		if (in_heap(prev_ptr)) {
-			remove_block(prev_ptr);
-		}
-		if (in_heap(next_ptr)) {
-			remove_block(next_ptr);
-		}
-		size_t next_size = get_size(next_ptr);
-                size += next_size + prev_size;
-                set_size(prev_ptr, size);
-                set_alloc(prev_ptr, false);
+	//merge with prev block
+	if ((prev_footer & 0x1) == 0) {
+		char* prev_ptr = (char*)ptr - (prev_footer & ~(uint64_t)0xF);
+		remove_block(prev_ptr);
+		size += get_size(prev_ptr);
+		heap_stats.coalesces++;
+		forget(ptr);
 		ptr = prev_ptr;
-		return ptr;
 	}
+
+	set_size(ptr, size);
+	set_alloc(ptr, false);
 	return ptr;
 }
 
@@ -411,6 +1013,12 @@ void free(void* ptr)
 		return;
 	}
 
+	int c = page_class(ptr);
+	if (c != 0) {
+		small_free(ptr, c);
+		return;
+	}
+
 	//Free block
 	uint64_t old_header = *(uint64_t*)((char*)ptr - 8);
 	size_t block_size = old_header & ~(uint64_t)0xF;
@@ -418,12 +1026,20 @@ void free(void* ptr)
 	//set alloc bits to 0
 	*(uint64_t*)((char*)ptr - 8) = block_size;
 	*(uint64_t*)((char*)ptr + block_size - 16) = block_size;
+	heap_stats.alloc_bytes -= block_size;
+	heap_stats.alloc_blocks--;
 
 	//coalesce if able
 //	printf("[free] freeing ptr=%p, block_size=%zu\n", ptr, (size_t)block_size);
-//	ptr = coalesce(ptr);
+	if (coalescing) {
+		ptr = coalesce(ptr);
+	}
 
-	insert_block(ptr);
+	insert_block(ptr, purge_clock);
+	if (check_incremental) {
+		touch(ptr);
+	}
+	purge_tick();
 }
 
 /*
@@ -442,6 +1058,23 @@ void* realloc(void* oldptr, size_t size)
 		return NULL;
 	}
 
+	//small objects stay put while the new size fits their class
+	int c = page_class(oldptr);
+	if (c != 0) {
+		if (size <= 16 * (size_t)c) {
+			return oldptr;
+		}
+		void* new_ptr = malloc(size);
+		if (new_ptr == NULL) {
+			return NULL;
+		}
+		memcpy(new_ptr, oldptr, 16 * (size_t)c);
+		small_free(oldptr, c);
+		heap_stats.realloc_copies++;
+		heap_stats.realloc_copy_bytes += 16 * (size_t)c;
+		return new_ptr;
+	}
+
 	//make base 16 size & add footer/header
 	size_t space = size + 16;
 	if (space % 16 != 0) {
@@ -454,6 +1087,12 @@ void* realloc(void* oldptr, size_t size)
 
 	//check if space fits in current block
 	size_t block_size = get_size(oldptr);
+	//a mark left from before growth hints were turned off counts for nothing
+	bool grown = realloc_growth && (*(uint64_t*)((char*)oldptr - 8) & GROWN) != 0;
+	if (grown && block_size >= space && space > block_size / 2) {
+		//keep the reserve while the block is still growing into it
+		return oldptr;
+	}
 	if (block_size >= space) {
 		//not calling malloc, therefore implement split
 		size_t leftover = block_size - space;
@@ -465,13 +1104,30 @@ void* realloc(void* oldptr, size_t size)
 			set_alloc(leftover_ptr, false);
 			set_prev(leftover_ptr, NULL);
 			set_next(leftover_ptr, NULL);
-			insert_block(leftover_ptr);
+			heap_stats.alloc_bytes -= leftover;
+			heap_stats.splits++;
+			if (coalescing) {
+				leftover_ptr = coalesce(leftover_ptr);
+			}
+			insert_block(leftover_ptr, purge_clock);
+			if (check_incremental) {
+				touch(oldptr);
+				touch(leftover_ptr);
+			}
 		}
 		return oldptr;
 	} else {
 
 	//else, malloc new ptr, copy data to here
-	void* new_ptr = malloc(size);
+	//a block that keeps growing gets as much again in reserve
+	size_t request = size;
+	if (grown) {
+		request += (block_size < GROW_MAX_SLACK) ? block_size : GROW_MAX_SLACK;
+	}
+	void* new_ptr = malloc(request);
+	if (new_ptr == NULL && request != size) {
+		new_ptr = malloc(size);
+	}
 	if (new_ptr == NULL) {
 		return NULL;
 	}
@@ -482,6 +1138,11 @@ void* realloc(void* oldptr, size_t size)
 	}
 	memcpy(new_ptr, oldptr, data);
 	free(oldptr);
+	heap_stats.realloc_copies++;
+	heap_stats.realloc_copy_bytes += data;
+	if (realloc_growth && page_class(new_ptr) == 0) {
+		set_grown(new_ptr);
+	}
 	return new_ptr;
 	}
 }
@@ -521,17 +1182,182 @@ static bool aligned(const void* p)
 }
 */
 
+#define heap_error(line, ...) do { \
+	printf("mm_checkheap (called from line %d): ", line); \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+} while (0)
+
+//size, header/footer and neighbour checks for one block
+static bool check_block(char* ptr, int line) {
+	if (!in_heap(ptr - 8) || !aligned(ptr)) {
+		heap_error(line, "block %p is misaligned or outside the heap", ptr);
+		return false;
+	}
+	uint64_t header = *(uint64_t*)(ptr - 8);
+	size_t size = header & ~(uint64_t)0xF;
+	if (size < 32 || size % ALIGNMENT != 0) {
+		heap_error(line, "block %p has bad size %zu", ptr, size);
+		return false;
+	}
+	//the block and the header after it must both be in the heap
+	if (!in_heap(ptr + size - 1)) {
+		heap_error(line, "block %p of size %zu runs past the heap", ptr, size);
+		return false;
+	}
+	if (*(uint64_t*)(ptr + size - 16) != header) {
+		heap_error(line, "block %p header 0x%lx does not match footer 0x%lx",
+			ptr, (unsigned long)header,
+			(unsigned long)*(uint64_t*)(ptr + size - 16));
+		return false;
+	}
+	if (coalescing && (header & 0x1) == 0) {
+		uint64_t prev_footer = *(uint64_t*)(ptr - 16);
+		if ((prev_footer & 0x1) == 0 || !get_alloc(ptr + size)) {
+			heap_error(line, "free block %p has a free neighbour", ptr);
+			return false;
+		}
+	}
+	return true;
+}
+
+//a free block must be linked both ways and sit on the list for its size
+static bool check_free_links(char* ptr, int index, int line) {
+	if (get_alloc(ptr)) {
+		heap_error(line, "allocated block %p is on free list %d", ptr, index);
+		return false;
+	}
+	if (get_list(get_size(ptr)) != index) {
+		heap_error(line, "block %p of size %zu is on list %d, belongs on %d",
+			ptr, get_size(ptr), index, get_list(get_size(ptr)));
+		return false;
+	}
+	char* prev = get_prev(ptr);
+	char* next = get_next(ptr);
+	if ((prev == NULL && seg_lists[index] != ptr)
+		|| (prev != NULL && (!in_heap(prev) || get_next(prev) != ptr))) {
+		heap_error(line, "block %p prev link %p does not point back", ptr, prev);
+		return false;
+	}
+	if (next != NULL && (!in_heap(next) || get_prev(next) != ptr)) {
+		heap_error(line, "block %p next link %p does not point back", ptr, next);
+		return false;
+	}
+	return true;
+}
+
+//walk every block from the prologue to the epilogue, then every list
+static bool check_heap(int line) {
+	if (*(uint64_t*)hlst_ptr != 0x11 || *(uint64_t*)(hlst_ptr + 8) != 0x11) {
+		heap_error(line, "prologue is corrupted");
+		return false;
+	}
+	size_t walk_free = 0;
+	char* ptr = hlst_ptr + 24;
+	while (get_size(ptr) != 0) {
+		if (!check_block(ptr, line)) {
+			return false;
+		}
+		if (!get_alloc(ptr)) {
+			walk_free++;
+		}
+		ptr += get_size(ptr);
+	}
+	if (ptr - 8 != (char*)mm_heap_hi() - 7 || *(uint64_t*)(ptr - 8) != 0x1) {
+		heap_error(line, "heap walk ended at %p, not at the epilogue", ptr - 8);
+		return false;
+	}
+
+	size_t list_free = 0;
+	for (int i = 0; i < NUM_LISTS; i++) {
+		size_t count = 0;
+		for (char* block = seg_lists[i]; block != NULL; block = get_next(block)) {
+			if (!in_heap(block) || !aligned(block) || ++count > walk_free) {
+				heap_error(line, "free list %d reaches %p, which is not a free block",
+					i, block);
+				return false;
+			}
+			if (!check_free_links(block, i, line)) {
+				return false;
+			}
+		}
+		if (count != heap_stats.free_blocks[i]) {
+			heap_error(line, "free list %d holds %zu blocks, stats say %zu",
+				i, count, heap_stats.free_blocks[i]);
+			return false;
+		}
+		list_free += count;
+	}
+	if (list_free != walk_free) {
+		heap_error(line, "%zu free blocks in the heap, %zu on free lists",
+			walk_free, list_free);
+		return false;
+	}
+
+	//every free small object must sit in a run page of its class
+	size_t max_objects = heap_stats.small_runs * RUN_PAGES * BIBOP_PAGE / 16;
+	for (int c = 1; c <= BIBOP_CLASSES; c++) {
+		size_t count = 0;
+		for (char* obj = small_lists[c - 1]; obj != NULL; obj = small_next(obj)) {
+			if (!in_heap(obj) || !aligned(obj) || page_class(obj) != c
+				|| ++count > max_objects) {
+				heap_error(line, "small list %d reaches %p, which is not in a run of its class",
+					c, obj);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//check just the blocks touched since the last call
+static bool check_touched(int line) {
+	for (size_t i = 0; i < num_touched; i++) {
+		char* ptr = touched[i];
+		if (ptr == NULL) {
+			continue;
+		}
+		if (!check_block(ptr, line)) {
+			return false;
+		}
+		if (get_alloc(ptr)) {
+			continue;
+		}
+		int index = get_list(get_size(ptr));
+		if (!check_free_links(ptr, index, line)) {
+			return false;
+		}
+		//prev links must lead back to the list head
+		size_t steps = 0;
+		char* block = ptr;
+		while (get_prev(block) != NULL && steps++ < heap_stats.free_blocks[index]) {
+			block = get_prev(block);
+		}
+		if (block != seg_lists[index]) {
+			heap_error(line, "free block %p is not reachable from list %d",
+				ptr, index);
+			return false;
+		}
+	}
+	return true;
+}
+
 /*
  * mm_checkheap
  * You call the function via mm_checkheap(__LINE__)
  * The line number can be used to print the line number of the calling
  * function where there was an invalid heap.
+ * In incremental mode only the blocks touched since the previous call
+ * are checked, falling back to a full walk if too many were touched.
  */
 bool mm_checkheap(int line_number)
 {
-#ifdef DEBUG
-    // Write code to check heap invariants here
-    // IMPLEMENT THIS
-#endif // DEBUG
-    return true;
+	bool ok;
+	if (check_incremental && num_touched <= CHECK_RING) {
+		ok = check_touched(line_number);
+	} else {
+		ok = check_heap(line_number);
+	}
+	num_touched = 0;
+	return ok;
 }
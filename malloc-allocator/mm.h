@@ -21,5 +21,61 @@ extern void* calloc (size_t nmemb, size_t size);
 
 extern bool mm_init(void);
 
+/* Number of segregated free lists in mm.c */
+#define MM_NUM_LISTS 7
+
+/*
+ * Allocator counters returned by mm_stats.  Byte counts include block
+ * headers and footers.  Counters are reset by mm_init.
+ */
+typedef struct {
+    size_t alloc_bytes;                 /* bytes in allocated blocks */
+    size_t alloc_blocks;
+    size_t free_bytes[MM_NUM_LISTS];    /* bytes on each free list */
+    size_t free_blocks[MM_NUM_LISTS];
+    size_t extend_calls;                /* calls to extend_heap */
+    size_t sbrk_bytes;                  /* total bytes obtained from mm_sbrk */
+    size_t splits;
+    size_t coalesces;
+    size_t searches;                    /* free-list searches by malloc */
+    size_t search_steps;                /* blocks examined by those searches */
+    size_t purges;                      /* free blocks whose pages were released */
+    size_t purged_bytes;                /* bytes handed back by those purges */
+    size_t small_runs;                  /* BIBOP runs carved so far */
+    size_t small_bytes;                 /* bytes in live BIBOP objects */
+    size_t realloc_copies;              /* reallocs that moved their block */
+    size_t realloc_copy_bytes;          /* payload bytes those moves copied */
+} mm_stats_t;
+extern mm_stats_t mm_stats(void);
+
+/* Visit every block in address order; sizes include header and footer */
+typedef void (*mm_walk_fn)(void* ptr, size_t size, bool allocated, void* ctx);
+extern void mm_heap_walk(mm_walk_fn fn, void* ctx);
+
+/* Size-class tables for the segregated lists, see mm_set_size_classes */
+enum { MM_CLASSES_DEFAULT, MM_CLASSES_TUNED, MM_CLASSES_ADAPTIVE };
+extern void mm_set_size_classes(int mode);
+
+/* Placement policies within a size class, see mm_set_policy */
+enum { MM_FIT_FIRST, MM_FIT_NEXT, MM_FIT_BEST, MM_FIT_GOOD };
+extern void mm_set_policy(int fit, int good_k, bool addr_ordered);
+
 /* This is for debugging.  Returns false if error encountered */
 extern bool mm_checkheap(int line_number);
+extern void mm_set_checkheap_incremental(bool enable);
+
+/* Save and reopen the heap across runs when memlib is file-backed */
+extern bool mm_checkpoint(void* root);
+extern bool mm_restore(void** root);
+
+/* Merge free blocks with free neighbours (off by default) */
+extern void mm_set_coalescing(bool enable);
+
+/* Serve small requests from headerless size-class runs (off by default) */
+extern void mm_set_bibop(bool enable);
+
+/* Over-allocate blocks that realloc keeps growing (off by default) */
+extern void mm_set_realloc_growth(bool enable);
+
+/* Release the pages of large, idle free blocks (threshold 0: off) */
+extern void mm_set_purge(size_t threshold, size_t decay);
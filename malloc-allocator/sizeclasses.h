@@ -0,0 +1,10 @@
+/*
+ * sizeclasses.h - generated by mkclasses.py from 24 trace(s)
+ * and 574783 requests.  Do not edit; rerun 'make classes'.
+ */
+#ifndef __SIZECLASSES_H_
+#define __SIZECLASSES_H_
+
+#define SIZECLASS_LIMITS {32, 48, 64, 80, 96, 112}
+
+#endif /* __SIZECLASSES_H_ */